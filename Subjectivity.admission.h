@@ -0,0 +1,164 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_ADMISSION_H
+#define SUBJECTIVITY_ADMISSION_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+/**
+ * @brief How willing the daemon is to shed an event type under load.
+ *
+ * - ADMIT_CRITICAL: never shed by queue depth (shutdown, overload).
+ * - ADMIT_NORMAL: shed once the queue reaches the shed depth.
+ * - ADMIT_LOW: shed from half the shed depth, so it gives way first.
+ */
+enum AdmissionClass : uint8_t {
+    ADMIT_CRITICAL,
+    ADMIT_NORMAL,
+    ADMIT_LOW
+};
+
+enum AdmissionVerdict : uint8_t {
+    ADMITTED,
+    SHED_RATE,  // token bucket del tipo vacío
+    SHED_DEPTH  // cola demasiado profunda para la clase del tipo
+};
+
+/**
+ * @class AdmissionControl
+ * @brief Decides which evaluations enter the queue in front of `evaluateAction`.
+ *
+ * Two independent checks, cheapest first:
+ * - queue depth: once the evaluations queued in the current pass reach the
+ *   class threshold, the request is shed. The depth is what the daemon
+ *   admitted from the frames read in this loop pass; requests still in
+ *   socket buffers are not counted, so it bounds the work of one pass rather
+ *   than the whole backlog;
+ * - rate: a per-event-type token bucket (`rate` tokens/s, up to `burst`);
+ *   types without a configured rate are not rate limited.
+ *
+ * Shed requests are not evaluated: they get the default verdict
+ * (`setDefaultVerdict`, 0 = action denied), sent before the pass's batches
+ * run. Types that were not configured share one "other" entry, so
+ * arbitrary client strings cannot grow the table.
+ */
+class AdmissionControl {
+private:
+    struct TypeState {
+        AdmissionClass admissionClass = ADMIT_NORMAL;
+        double rate = 0.0; // tokens por segundo; 0 = sin límite
+        double burst = 0.0;
+        double tokens = 0.0;
+        double lastRefill = 0.0;
+        uint64_t admitted = 0;
+        uint64_t shedRate = 0;
+        uint64_t shedDepth = 0;
+    };
+
+    std::unordered_map<std::string, TypeState> types = {
+        {"shutdown", TypeState{ADMIT_CRITICAL}},
+        {"overload", TypeState{ADMIT_CRITICAL}},
+        {"external_interrupt", TypeState{ADMIT_NORMAL}},
+        {"logic_conflict", TypeState{ADMIT_LOW}}
+    };
+    TypeState other;
+    size_t shedDepth;
+    uint8_t defaultVerdict = 0; // acción denegada: la respuesta conservadora
+
+    TypeState& stateFor(const std::string& eventType) {
+        auto it = types.find(eventType);
+        return it != types.end() ? it->second : other;
+    }
+
+public:
+    static constexpr size_t kDefaultShedDepth = 4096;
+
+    explicit AdmissionControl(size_t shedDepth = kDefaultShedDepth) : shedDepth(shedDepth) {}
+
+    /**
+     * @param depth Queued evaluations at which ADMIT_NORMAL types are shed;
+     *        0 disables depth-based shedding.
+     */
+    void setShedDepth(size_t depth) { shedDepth = depth; }
+
+    void setClass(const std::string& eventType, AdmissionClass admissionClass) {
+        types[eventType].admissionClass = admissionClass;
+    }
+
+    /**
+     * @brief Rate-limits `eventType` to `rate` requests/s with bursts of `burst`.
+     *
+     * A rate of 0 removes the limit.
+     */
+    void setRate(const std::string& eventType, double rate, double burst) {
+        TypeState& state = types[eventType];
+        state.rate = std::max(rate, 0.0);
+        state.burst = std::max(burst, 1.0);
+        state.tokens = state.burst;
+        state.lastRefill = 0.0;
+    }
+
+    /**
+     * @brief Verdict returned for shed requests: 0 denies the action (default), 1 accepts it.
+     */
+    void setDefaultVerdict(uint8_t verdict) { defaultVerdict = verdict ? 1 : 0; }
+
+    uint8_t getDefaultVerdict() const { return defaultVerdict; }
+
+    /**
+     * @param eventType Event type of the evaluation.
+     * @param queued Evaluations already queued ahead of this one in the current pass.
+     * @param now Monotonic time in seconds.
+     */
+    AdmissionVerdict admit(const std::string& eventType, size_t queued, double now) {
+        TypeState& state = stateFor(eventType);
+
+        if (shedDepth > 0 && state.admissionClass != ADMIT_CRITICAL) {
+            size_t limit = state.admissionClass == ADMIT_LOW ? shedDepth / 2 : shedDepth;
+            if (queued >= limit) {
+                state.shedDepth++;
+                return SHED_DEPTH;
+            }
+        }
+
+        if (state.rate > 0.0) {
+            if (state.lastRefill == 0.0) state.lastRefill = now;
+            state.tokens = std::min(state.burst, state.tokens + (now - state.lastRefill) * state.rate);
+            state.lastRefill = now;
+            if (state.tokens < 1.0) {
+                state.shedRate++;
+                return SHED_RATE;
+            }
+            state.tokens -= 1.0;
+        }
+
+        state.admitted++;
+        return ADMITTED;
+    }
+
+    uint64_t shedTotal() const {
+        uint64_t total = other.shedRate + other.shedDepth;
+        for (const auto& entry : types) total += entry.second.shedRate + entry.second.shedDepth;
+        return total;
+    }
+
+    void printStats() const {
+        auto print = [](const std::string& name, const TypeState& state) {
+            if (state.admitted + state.shedRate + state.shedDepth == 0) return;
+            std::cout << "  " << name << ": admitted " << state.admitted
+                      << " | shed (rate) " << state.shedRate
+                      << " | shed (depth) " << state.shedDepth << "\n";
+        };
+        std::cout << "Admission (shed depth " << shedDepth << "):\n";
+        for (const auto& entry : types) print(entry.first, entry.second);
+        print("<other>", other);
+    }
+};
+
+#endif
@@ -0,0 +1,69 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_ARENA_H
+#define SUBJECTIVITY_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+/**
+ * @class ReplicaArena
+ * @brief Monotonic memory for one scenario or replica, freed all at once.
+ *
+ * Agents built with `SyntheticSelf(arena.resource())` take every vector,
+ * map node, string and sketch level from the arena by bumping a pointer;
+ * freeing is a no-op. When the replica ends, destroy its agents and call
+ * `reset`: the memory is handed back in one step and the first block is
+ * kept, so the next replica of a similar size never reaches the heap.
+ *
+ * The first block and any overflow come from `upstream`; pass a
+ * `HugePageResource` to put the whole replica on huge pages of one NUMA node.
+ *
+ * Memory released by a growing vector is not reused until `reset`, so a
+ * replica needs up to about twice its live state. Not thread-safe: use one
+ * arena per thread or replica.
+ */
+class ReplicaArena {
+private:
+    size_t initialBytes;
+    std::pmr::memory_resource* upstream;
+    void* initial;
+    std::pmr::monotonic_buffer_resource arena;
+
+public:
+    static constexpr size_t kDefaultInitialBytes = 1 << 20;
+
+    /**
+     * @param initialBytes Size of the block kept across resets.
+     * @param upstream Where the first block and overflow blocks come from.
+     */
+    explicit ReplicaArena(size_t initialBytes = kDefaultInitialBytes,
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : initialBytes(initialBytes),
+          upstream(upstream),
+          initial(upstream->allocate(initialBytes, alignof(std::max_align_t))),
+          arena(initial, initialBytes, upstream) {}
+
+    ReplicaArena(const ReplicaArena&) = delete;
+    ReplicaArena& operator=(const ReplicaArena&) = delete;
+
+    ~ReplicaArena() {
+        arena.release();
+        upstream->deallocate(initial, initialBytes, alignof(std::max_align_t));
+    }
+
+    std::pmr::memory_resource* resource() { return &arena; }
+
+    /**
+     * @brief Frees everything allocated since the last reset.
+     *
+     * Every object using the arena must already be destroyed.
+     */
+    void reset() { arena.release(); }
+
+    size_t initialSize() const { return initialBytes; }
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_CLOCK_H
+#define SUBJECTIVITY_CLOCK_H
+
+#include <cstdint>
+#include <ctime>
+
+/**
+ * @brief Nanoseconds on `clock` (CLOCK_REALTIME for wall time).
+ */
+inline uint64_t clockNs(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Nanoseconds on CLOCK_MONOTONIC: spans, latencies, idle times.
+ *
+ * The same clock in every process, so the stats page heartbeat can be
+ * compared by its readers.
+ */
+inline uint64_t monotonicNs() {
+    return clockNs(CLOCK_MONOTONIC);
+}
+
+#endif
@@ -0,0 +1,1140 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_DAEMON_H
+#define SUBJECTIVITY_DAEMON_H
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Subjectivity.h"
+#include "Subjectivity.protocol.h"
+#include "Subjectivity.admission.h"
+#include "Subjectivity.journal.h"
+#include "Subjectivity.store.h"
+#include "Subjectivity.statspage.h"
+#include "Subjectivity.metrics.h"
+#include "Subjectivity.trace.h"
+#include "Subjectivity.uring.h"
+
+/**
+ * @brief I/O strategy of the daemon's socket loop.
+ *
+ * `IO_AUTO` picks io_uring when the kernel supports everything the loop needs
+ * (multishot accept/receive, provided buffer rings) and epoll otherwise.
+ */
+enum DaemonIo {
+    IO_AUTO,
+    IO_EPOLL,
+    IO_URING
+};
+
+/**
+ * @class EvaluationDaemon
+ * @brief Serves a set of shared `SyntheticSelf` agents over a Unix-domain socket.
+ *
+ * A single thread runs the socket loop. Each pass drains every readable
+ * connection and decodes all complete frames (clients may pipeline).
+ * OP_EVALUATE frames are queued per agent and folded into one `evaluateBatch`
+ * call per agent; any other op flushes its own agent's queue first, so every
+ * agent still sees its requests in arrival order. Agents are independent, so
+ * batches of different agents may run in any order. When a journal is enabled
+ * the state-changing frames of the pass are committed (group commit) before
+ * any response leaves. Responses are written back in request order for each
+ * connection.
+ *
+ * Two interchangeable loops drive the sockets: an edge-triggered epoll loop
+ * with `recv`/`send`, and an io_uring loop with multishot accept, multishot
+ * receive into a provided-buffer ring, and asynchronous sends.
+ *
+ * Priority lane: OP_KILL_SWITCH frames and "shutdown" evaluations run before
+ * every evaluation queued in the same pass, and a second socket (`<socketPath>.prio`) carries urgent
+ * traffic (kill switches, shutdown-type events) that preempts batch
+ * processing. Batches are evaluated in chunks of `kPriorityChunk` and the lane
+ * is polled between chunks, so a lane request waits for at most one chunk
+ * instead of the whole backlog. Lane frames are executed one by one, ahead of
+ * anything still queued for the same agent, and answered immediately.
+ *
+ * On the main socket, responses keep request order per connection. Before
+ * the queued batches run, the journal is committed and every connection
+ * gets the responses already decided (kill switches, shed or invalid
+ * requests) up to its first frame still waiting for a batch; the rest
+ * leave after the batches and the final journal commit.
+ *
+ * Admission control sits in front of the evaluation queue: queued OP_EVALUATE
+ * frames go through `AdmissionControl` (per-type token buckets and
+ * queue-depth shedding by event class), and refused ones are answered with
+ * STATUS_SHED and the configured default verdict before the queued batches
+ * run. Lane frames and the urgent frames above bypass it.
+ *
+ * With `enableStore` the agents live in an `AgentStore` file instead of
+ * memory: none is built at startup, each is read from the store the first
+ * time a frame addresses it, and the touched ones are written back when the
+ * loop stops.
+ *
+ * With `enableStatsPage` the loop also publishes its counters, queue depth,
+ * pass/batch latency histograms and per-agent thresholds to a shared-memory
+ * page (`Subjectivity.statspage.h`) that on-call tools read without touching
+ * the daemon. `enableMetrics` records Prometheus metrics
+ * (`Subjectivity.metrics.h`) for an exporter running on another thread.
+ * When the global `Tracer` is enabled, each loop iteration is one sampling
+ * unit, traced as ingest / pass / batch / journal spans; kill switches and
+ * lane frames are always traced.
+ */
+class EvaluationDaemon {
+private:
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        bool closing = false;
+        bool touched = false;
+        bool repliesHeld = false; // una petición anterior aún espera su lote
+        // epoll
+        bool wantWrite = false;
+        // io_uring
+        std::string sending;    // buffer owned by the in-flight send
+        size_t sendOffset = 0;
+        int inflight = 0;       // operaciones pendientes que apuntan a esta conexión
+        bool shutdownDone = false;
+    };
+
+    struct Pending {
+        Connection* conn;
+        FrameHeader header;
+        size_t offset; // start of the payload inside conn->in
+        uint8_t status = STATUS_OK;
+        uint32_t replyLength = 0;
+        bool urgent = false;   // corre antes que las evaluaciones en cola
+        bool answered = false;
+        bool sent = false;     // respuesta adelantada por sendAnswered
+        bool journaled = false;
+        uint64_t journalRecord = 0; // número en el journal; UINT64_MAX si no entró
+        char reply[sizeof(WireStats)];
+    };
+
+    struct AgentBatch {
+        std::vector<EvalRequest> requests;
+        std::vector<Pending*> owners;
+    };
+
+    enum : uint64_t {
+        TAG_ACCEPT = 1,
+        TAG_RECV = 2,
+        TAG_SEND = 3,
+        TAG_TIMEOUT = 4,
+        TAG_PRIORITY = 5,
+        TAG_MASK = 7
+    };
+
+    static constexpr unsigned kRecvBuffers = 256;      // potencia de dos
+    static constexpr unsigned kRecvBufferSize = 16384;
+    static constexpr size_t kPriorityChunk = 64; // evaluaciones entre consultas al carril
+
+    std::string socketPath;
+    size_t agentCount;
+    std::vector<SyntheticSelf> agents; // vacío mientras no se necesitan, o con almacén
+    AgentStore store;
+    DaemonIo requestedIo;
+    bool uring = false;
+    int listenFd = -1;
+    int epollFd = -1;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> touched;
+
+    std::vector<Pending> pending;
+    std::vector<AgentBatch> batches; // uno por agente
+    std::vector<uint16_t> batchedAgents;
+    std::vector<EvalRequest> chunk;
+
+    SyntheticSelf& agentAt(uint16_t index) {
+        return store.isOpen() ? store.get(index) : agents[index];
+    }
+
+    void buildAgents() {
+        if (store.isOpen() || !agents.empty()) return;
+        agents.resize(agentCount);
+        for (auto& agent : agents) agent.setVerbose(false);
+    }
+    std::vector<uint8_t> verdicts;
+    size_t queuedEvaluations = 0;
+    double passStart = 0.0;
+    AdmissionControl admission;
+
+    int laneListenFd = -1;
+    int laneEpollFd = -1;
+    std::vector<std::unique_ptr<Connection>> laneConnections;
+    std::vector<Pending> lanePending;
+    Connection laneMarker; // identifica al carril prioritario en el epoll principal
+
+    Journal journal;
+    std::vector<char> recvBuffers;
+    __kernel_timespec tick{0, 100 * 1000 * 1000};
+    IoUring ring; // declarado al final: se destruye antes que los buffers que usa
+
+    uint64_t requestsServed = 0;
+    uint64_t batchesRun = 0;
+    size_t largestBatch = 0;
+    uint64_t priorityServed = 0;
+    StatsPagePublisher statsPage;
+    std::unique_ptr<DecisionMetrics> metrics;
+
+    bool timed() const { return statsPage.isOpen() || metrics; }
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    Connection* addConnection(int fd) {
+        auto conn = std::make_unique<Connection>();
+        conn->fd = fd;
+        connections.push_back(std::move(conn));
+        return connections.back().get();
+    }
+
+    static void removeFrom(std::vector<std::unique_ptr<Connection>>& list, Connection* conn) {
+        close(conn->fd);
+        for (auto& c : list) {
+            if (c.get() == conn) {
+                c = std::move(list.back());
+                list.pop_back();
+                break;
+            }
+        }
+    }
+
+    void removeConnection(Connection* conn) {
+        removeFrom(connections, conn);
+    }
+
+    void touch(Connection* conn) {
+        if (conn->touched) return;
+        conn->touched = true;
+        touched.push_back(conn);
+    }
+
+    /**
+     * @brief Queues every complete frame buffered in `conn->in` into `into`.
+     */
+    static void parseFrames(Connection* conn, std::vector<Pending>& into) {
+        size_t offset = 0;
+        while (conn->in.size() - offset >= sizeof(FrameHeader)) {
+            FrameHeader header;
+            std::memcpy(&header, conn->in.data() + offset, sizeof(header));
+            if (header.length > kMaxFramePayload) {
+                conn->closing = true; // flujo corrupto: no hay forma de resincronizar
+                break;
+            }
+            if (conn->in.size() - offset < sizeof(FrameHeader) + header.length) break;
+            Pending p;
+            p.conn = conn;
+            p.header = header;
+            p.offset = offset + sizeof(FrameHeader);
+            into.push_back(p);
+            offset += sizeof(FrameHeader) + header.length;
+        }
+    }
+
+    /**
+     * @brief Drops the frames consumed by the last pass from `conn->in`.
+     */
+    static void compactInput(Connection* conn) {
+        size_t consumed = 0;
+        while (conn->in.size() - consumed >= sizeof(FrameHeader)) {
+            FrameHeader header;
+            std::memcpy(&header, conn->in.data() + consumed, sizeof(header));
+            if (conn->in.size() - consumed < sizeof(FrameHeader) + header.length) break;
+            consumed += sizeof(FrameHeader) + header.length;
+        }
+        conn->in.erase(0, consumed);
+    }
+
+    /**
+     * @brief Evaluates an agent's queued requests, serving the lane between chunks.
+     *
+     * Evaluations are journaled when they run rather than when they are queued,
+     * so the journal keeps execution order even when lane frames overtake them.
+     */
+    void flushBatch(uint16_t agent) {
+        AgentBatch& batch = batches[agent];
+        if (batch.requests.empty()) return;
+        AgentStats before{};
+        if (metrics) before = agentAt(agent).readStats();
+        for (size_t start = 0; start < batch.requests.size(); start += kPriorityChunk) {
+            size_t end = std::min(start + kPriorityChunk, batch.requests.size());
+            TraceSpan span("batch");
+            chunk.assign(std::make_move_iterator(batch.requests.begin() + start),
+                         std::make_move_iterator(batch.requests.begin() + end));
+            for (size_t i = start; i < end; i++) journalFrame(*batch.owners[i]);
+            uint64_t began = timed() ? monotonicNs() : 0;
+            agentAt(agent).evaluateBatch(chunk, verdicts);
+            if (timed()) {
+                uint64_t elapsed = monotonicNs() - began;
+                statsPage.recordBatch(verdicts.data(), end - start, elapsed);
+                if (metrics) {
+                    metrics->observeBatch(elapsed);
+                    for (size_t i = 0; i < chunk.size(); i++)
+                        metrics->countDecision(chunk[i].eventType, verdicts[i] != 0);
+                }
+            }
+            for (size_t i = start; i < end; i++)
+                reply(*batch.owners[i], STATUS_OK, &verdicts[i - start], 1);
+            batchesRun++;
+            largestBatch = std::max(largestBatch, end - start);
+            servePriorityLane();
+        }
+        if (timed()) {
+            AgentStats after = agentAt(agent).readStats();
+            statsPage.publishAgent(agent, after);
+            if (metrics) metrics->observeAgent(agent, before, after);
+        }
+        queuedEvaluations -= batch.requests.size();
+        batch.requests.clear();
+        batch.owners.clear();
+    }
+
+    void flushAllBatches() {
+        for (uint16_t agent : batchedAgents) flushBatch(agent);
+        batchedAgents.clear();
+    }
+
+    static void reply(Pending& p, uint8_t status, const void* payload = nullptr, uint32_t length = 0) {
+        p.answered = true;
+        p.status = status;
+        p.replyLength = length;
+        if (length) std::memcpy(p.reply, payload, length);
+    }
+
+    void journalFrame(Pending& p) {
+        if (!journal.isOpen()) return;
+        const char* frame = p.conn->in.data() + p.offset - sizeof(FrameHeader);
+        p.journaled = true;
+        p.journalRecord = journal.appended();
+        if (!journal.append(frame, sizeof(FrameHeader) + p.header.length)) {
+            perror("[JOURNAL] append");
+            p.journalRecord = UINT64_MAX;
+        }
+    }
+
+    /**
+     * @brief Appends the response of `p` to `out`.
+     *
+     * A journaled request is only acknowledged once its record is durable;
+     * otherwise it is answered STATUS_NOT_DURABLE.
+     */
+    void writeReply(Pending& p, std::string& out) {
+        if (p.journaled && p.journalRecord >= journal.durable()) {
+            p.status = STATUS_NOT_DURABLE;
+            p.replyLength = 0;
+        }
+        appendFrame(out, p.header.op, p.header.requestId, p.header.agent, p.reply, p.replyLength, p.status);
+    }
+
+    /**
+     * @param immediate Run the frame now, ahead of anything queued for its
+     *        agent (priority lane), instead of keeping arrival order.
+     */
+    void dispatch(Pending& p, bool immediate = false) {
+        const char* payload = p.conn->in.data() + p.offset;
+        const FrameHeader& h = p.header;
+        requestsServed++;
+        statsPage.countRequests(1);
+
+        if (h.agent >= agentCount) {
+            reply(p, STATUS_UNKNOWN_AGENT);
+            return;
+        }
+
+        if (h.op == OP_EVALUATE) {
+            EvalRequest request;
+            if (!decodeTypedPayload(payload, h.length, request.risk, request.eventType,
+                                    true, &request.causedConsequence)) {
+                reply(p, STATUS_BAD_REQUEST);
+                return;
+            }
+            if (immediate) {
+                journalFrame(p);
+                SyntheticSelf& agent = agentAt(h.agent);
+                AgentStats before = agent.readStats();
+                uint64_t began = timed() ? monotonicNs() : 0;
+                uint8_t accepted = agent.evaluateAction(
+                    request.risk, request.eventType, request.causedConsequence) ? 1 : 0;
+                // Un lote de uno: cuenta en el veredicto y la latencia como cualquier otro.
+                if (timed()) statsPage.recordBatch(&accepted, 1, monotonicNs() - began);
+                reply(p, STATUS_OK, &accepted, 1);
+                AgentStats after = agent.readStats();
+                statsPage.publishAgent(h.agent, after);
+                if (metrics) {
+                    metrics->countDecision(request.eventType, accepted != 0);
+                    metrics->observeAgent(h.agent, before, after);
+                }
+                return;
+            }
+            if (admission.admit(request.eventType, queuedEvaluations, passStart) != ADMITTED) {
+                uint8_t verdict = admission.getDefaultVerdict();
+                reply(p, STATUS_SHED, &verdict, 1);
+                statsPage.countShed();
+                if (metrics) metrics->countShed(request.eventType);
+                return;
+            }
+            AgentBatch& batch = batches[h.agent];
+            queuedEvaluations++;
+            statsPage.setQueueDepth(queuedEvaluations);
+            if (batch.requests.empty()) batchedAgents.push_back(h.agent);
+            batch.requests.push_back(std::move(request));
+            batch.owners.push_back(&p);
+            return;
+        }
+
+        if (!immediate) flushBatch(h.agent);
+        SyntheticSelf& agent = agentAt(h.agent);
+        float value;
+        std::string eventType;
+        switch (h.op) {
+        case OP_LOG_EVENT:
+            if (!decodeTypedPayload(payload, h.length, value, eventType)) break;
+            journalFrame(p);
+            agent.logEvent(eventType, value);
+            reply(p, STATUS_OK);
+            return;
+        case OP_SET_NECESSITY:
+            if (!decodeTypedPayload(payload, h.length, value, eventType)) break;
+            journalFrame(p);
+            agent.setEventNecessity(eventType, value);
+            reply(p, STATUS_OK);
+            return;
+        case OP_KILL_SWITCH: {
+            if (h.length != 1) break;
+            TraceSpan span("kill_switch", TRACE_ALWAYS);
+            journalFrame(p);
+            AgentStats before = agent.readStats();
+            uint8_t avoided = agent.simulateKillSwitch(payload[0] != 0) ? 1 : 0;
+            reply(p, STATUS_OK, &avoided, 1);
+            AgentStats after = agent.readStats();
+            statsPage.publishAgent(h.agent, after);
+            if (metrics) {
+                metrics->countKillSwitch(avoided != 0);
+                metrics->observeAgent(h.agent, before, after);
+            }
+            return;
+        }
+        case OP_STATS: {
+            if (h.length != 0) break;
+            WireStats stats{};
+            stats.decisions = agent.getDecisionCount();
+            stats.avoidedDangers = agent.getAvoidedDangerCount();
+            stats.overreactions = agent.getOverreactionCount();
+            stats.threshold = agent.currentThreshold();
+            stats.riskP50 = agent.riskQuantile(0.5);
+            stats.riskP95 = agent.riskQuantile(0.95);
+            stats.riskP99 = agent.riskQuantile(0.99);
+            reply(p, STATUS_OK, &stats, sizeof(stats));
+            return;
+        }
+        default:
+            break;
+        }
+        reply(p, STATUS_BAD_REQUEST);
+    }
+
+    /**
+     * @brief Kill switches and "shutdown" evaluations, run ahead of the queued evaluations.
+     */
+    static bool isUrgent(const Pending& p) {
+        if (p.header.op == OP_KILL_SWITCH) return true;
+        return p.header.op == OP_EVALUATE &&
+               payloadEventType(p.conn->in.data() + p.offset, p.header.length, true) == "shutdown";
+    }
+
+    /**
+     * @brief Sends the responses already decided, before the queued batches run.
+     *
+     * Per connection, only the leading answered frames go out, so responses
+     * keep request order. The journal is committed first: what was executed
+     * is durable before it is acknowledged.
+     */
+    void sendAnswered() {
+        commitJournal();
+        for (auto& p : pending) {
+            Connection* conn = p.conn;
+            if (conn->repliesHeld) continue;
+            if (!p.answered) {
+                conn->repliesHeld = true;
+                continue;
+            }
+            writeReply(p, conn->out);
+            p.sent = true;
+        }
+        for (auto& p : pending) {
+            Connection* conn = p.conn;
+            conn->repliesHeld = false;
+            // Con io_uring sólo si no hay un envío en vuelo sobre el socket.
+            if (!conn->out.empty() && conn->sending.empty() && !conn->closing) sendNow(conn);
+        }
+    }
+
+    /**
+     * @brief Runs every frame decoded in this pass and queues the responses.
+     */
+    void processPending() {
+        TraceSpan span("pass");
+        uint64_t began = timed() ? monotonicNs() : 0;
+        passStart = std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        servePriorityLane();
+        for (auto& p : pending) {
+            p.urgent = isUrgent(p);
+            if (p.urgent) dispatch(p, true);
+        }
+        for (auto& p : pending)
+            if (!p.urgent) dispatch(p);
+        if (!batchedAgents.empty()) sendAnswered();
+        flushAllBatches();
+        commitJournal();
+        for (auto& p : pending)
+            if (!p.sent) writeReply(p, p.conn->out);
+        pending.clear();
+        if (timed()) {
+            uint64_t ended = monotonicNs();
+            statsPage.setQueueDepth(0);
+            statsPage.recordPass(began, ended);
+            if (metrics) metrics->observePass(ended - began);
+        }
+    }
+
+    void commitJournal() {
+        if (!journal.isOpen()) return;
+        TraceSpan span("journal_commit");
+        // Lo no guardado sigue preparado: el siguiente commit lo reintenta, y
+        // mientras tanto sus peticiones se responden STATUS_NOT_DURABLE.
+        if (!journal.commit()) perror("[JOURNAL] commit");
+    }
+
+    /**
+     * @brief Applies one journal record to the agents (startup replay).
+     */
+    void applyJournalRecord(const FrameHeader& h, const char* payload) {
+        if (h.agent >= agentCount) return;
+        SyntheticSelf& agent = agentAt(h.agent);
+        float value;
+        bool flag = false;
+        std::string eventType;
+        switch (h.op) {
+        case OP_EVALUATE:
+            if (decodeTypedPayload(payload, h.length, value, eventType, true, &flag))
+                agent.evaluateAction(value, eventType, flag);
+            break;
+        case OP_LOG_EVENT:
+            if (decodeTypedPayload(payload, h.length, value, eventType))
+                agent.logEvent(eventType, value);
+            break;
+        case OP_SET_NECESSITY:
+            if (decodeTypedPayload(payload, h.length, value, eventType))
+                agent.setEventNecessity(eventType, value);
+            break;
+        case OP_KILL_SWITCH:
+            if (h.length == 1) agent.simulateKillSwitch(payload[0] != 0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // ---- carril prioritario ----
+
+    bool startPriorityLane() {
+        sockaddr_un addr{};
+        std::string lanePath = socketPath + ".prio";
+        if (lanePath.size() >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, lanePath.c_str(), sizeof(addr.sun_path) - 1);
+
+        laneListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (laneListenFd < 0) return false;
+        unlink(lanePath.c_str());
+        if (bind(laneListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) return false;
+        if (listen(laneListenFd, SOMAXCONN) < 0 || !setNonBlocking(laneListenFd)) return false;
+
+        laneEpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (laneEpollFd < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        return epoll_ctl(laneEpollFd, EPOLL_CTL_ADD, laneListenFd, &ev) == 0;
+    }
+
+    void acceptLane() {
+        for (;;) {
+            int fd = accept4(laneListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            auto conn = std::make_unique<Connection>();
+            conn->fd = fd;
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = conn.get();
+            if (epoll_ctl(laneEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                close(fd);
+                continue;
+            }
+            laneConnections.push_back(std::move(conn));
+        }
+    }
+
+    static void sendNow(Connection* conn) {
+        size_t sent = 0;
+        while (sent < conn->out.size()) {
+            ssize_t n = send(conn->fd, conn->out.data() + sent, conn->out.size() - sent,
+                             MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += (size_t)n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break; // EPOLLOUT reintenta
+            conn->closing = true;
+            conn->out.clear();
+            return;
+        }
+        conn->out.erase(0, sent);
+    }
+
+    /**
+     * @brief Executes and answers every frame waiting on the priority lane.
+     *
+     * Non-blocking; called when the lane is readable and between evaluation
+     * chunks. Lane frames never wait for queued batches.
+     */
+    void servePriorityLane() {
+        if (laneEpollFd < 0) return;
+        epoll_event events[16];
+        int ready;
+        while ((ready = epoll_wait(laneEpollFd, events, 16, 0)) > 0) {
+            for (int i = 0; i < ready; i++) {
+                Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+                if (!conn) {
+                    acceptLane();
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    readConnection(conn);
+
+                TraceSpan span("priority_lane", TRACE_ALWAYS);
+                lanePending.clear();
+                parseFrames(conn, lanePending);
+                for (auto& p : lanePending) dispatch(p, true);
+                commitJournal();
+                for (auto& p : lanePending) writeReply(p, conn->out);
+                priorityServed += lanePending.size();
+                statsPage.countPriority(lanePending.size());
+                compactInput(conn);
+                if (!conn->out.empty()) sendNow(conn);
+
+                if (conn->closing && conn->out.empty()) {
+                    epoll_ctl(laneEpollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+                    removeFrom(laneConnections, conn);
+                }
+            }
+        }
+    }
+
+    // ---- epoll ----
+
+    bool startEpoll() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; // nullptr identifica al socket de escucha
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0) return false;
+        ev.data.ptr = &laneMarker;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, laneEpollFd, &ev) == 0;
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // EAGAIN: backlog drained
+            }
+            Connection* conn = addConnection(fd);
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = conn;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) removeConnection(conn);
+        }
+    }
+
+    void readConnection(Connection* conn) {
+        char chunk[65536];
+        for (;;) {
+            ssize_t got = recv(conn->fd, chunk, sizeof(chunk), 0);
+            if (got > 0) {
+                conn->in.append(chunk, (size_t)got);
+                continue;
+            }
+            if (got < 0 && errno == EINTR) continue;
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) conn->closing = true;
+            break;
+        }
+    }
+
+    void writeConnection(Connection* conn) {
+        size_t sent = 0;
+        while (sent < conn->out.size()) {
+            ssize_t n = send(conn->fd, conn->out.data() + sent, conn->out.size() - sent,
+                             MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += (size_t)n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            conn->closing = true; // el cliente se fue: descartar lo pendiente
+            conn->out.clear();
+            return;
+        }
+        conn->out.erase(0, sent);
+
+        bool wantWrite = !conn->out.empty();
+        if (wantWrite != conn->wantWrite) {
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (wantWrite ? EPOLLOUT : 0);
+            ev.data.ptr = conn;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+            conn->wantWrite = wantWrite;
+        }
+    }
+
+    void runEpoll(const std::atomic<bool>& stop) {
+        std::vector<epoll_event> events(256);
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            int ready = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait");
+                return;
+            }
+
+            touched.clear();
+            Tracer::beginSample();
+            {
+                TraceSpan span("ingest");
+                for (int i = 0; i < ready; i++) {
+                    Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+                    if (!conn) {
+                        acceptAll();
+                        continue;
+                    }
+                    if (conn == &laneMarker) {
+                        servePriorityLane();
+                        continue;
+                    }
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                        readConnection(conn);
+                        parseFrames(conn, pending);
+                    }
+                    touch(conn);
+                }
+            }
+
+            processPending();
+
+            for (Connection* conn : touched) {
+                compactInput(conn);
+                if (!conn->out.empty()) writeConnection(conn);
+            }
+            for (Connection* conn : touched) {
+                conn->touched = false;
+                if (conn->closing && conn->out.empty()) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+                    removeConnection(conn);
+                }
+            }
+        }
+    }
+
+    // ---- io_uring ----
+
+    io_uring_sqe* nextSqe() {
+        io_uring_sqe* sqe = ring.getSqe();
+        if (!sqe) {
+            ring.submit(0); // cola llena: publicar lo preparado y reintentar
+            sqe = ring.getSqe();
+        }
+        return sqe;
+    }
+
+    bool startUring() {
+        if (!IoUring::kernelHasMultishotRecv() || !ring.init(4096)) return false;
+        if (!ring.supports({IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_TIMEOUT,
+                            IORING_OP_POLL_ADD}))
+            return false;
+        if (!ring.setupBufferRing(kRecvBuffers, 0)) return false;
+
+        recvBuffers.assign((size_t)kRecvBuffers * kRecvBufferSize, 0);
+        for (unsigned i = 0; i < kRecvBuffers; i++)
+            ring.provideBuffer(&recvBuffers[(size_t)i * kRecvBufferSize], kRecvBufferSize, (uint16_t)i);
+        ring.commitBuffers();
+
+        armAccept();
+        armTimeout();
+        armLanePoll();
+        return ring.submit(0) >= 0;
+    }
+
+    void armLanePoll() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = laneEpollFd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = TAG_PRIORITY;
+    }
+
+    void armAccept() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listenFd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = TAG_ACCEPT;
+    }
+
+    void armTimeout() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = reinterpret_cast<uint64_t>(&tick);
+        sqe->len = 1;
+        sqe->user_data = TAG_TIMEOUT;
+    }
+
+    void armRecv(Connection* conn) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = conn->fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->user_data = reinterpret_cast<uint64_t>(conn) | TAG_RECV;
+        conn->inflight++;
+    }
+
+    void armSend(Connection* conn) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = conn->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(conn->sending.data() + conn->sendOffset);
+        sqe->len = (uint32_t)(conn->sending.size() - conn->sendOffset);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = reinterpret_cast<uint64_t>(conn) | TAG_SEND;
+        conn->inflight++;
+    }
+
+    void handleCompletion(const io_uring_cqe& cqe) {
+        uint64_t tag = cqe.user_data & TAG_MASK;
+        Connection* conn = reinterpret_cast<Connection*>(cqe.user_data & ~(uint64_t)TAG_MASK);
+        bool more = cqe.flags & IORING_CQE_F_MORE;
+
+        switch (tag) {
+        case TAG_ACCEPT:
+            if (cqe.res >= 0) armRecv(addConnection(cqe.res));
+            if (!more) armAccept();
+            return;
+        case TAG_TIMEOUT:
+            armTimeout();
+            return;
+        case TAG_PRIORITY:
+            servePriorityLane();
+            if (!more) armLanePoll();
+            return;
+        case TAG_RECV:
+            if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+                uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                char* buffer = &recvBuffers[(size_t)bid * kRecvBufferSize];
+                conn->in.append(buffer, (size_t)cqe.res);
+                ring.provideBuffer(buffer, kRecvBufferSize, bid);
+            }
+            if (!more) {
+                conn->inflight--;
+                // -ENOBUFS: sin buffers libres; se rearma cuando se devuelvan.
+                if (cqe.res > 0 || cqe.res == -ENOBUFS) {
+                    if (!conn->closing) armRecv(conn);
+                } else {
+                    conn->closing = true;
+                }
+            }
+            touch(conn);
+            return;
+        case TAG_SEND:
+            conn->inflight--;
+            if (cqe.res < 0) {
+                conn->closing = true;
+                conn->sending.clear();
+                conn->sendOffset = 0;
+            } else {
+                conn->sendOffset += (size_t)cqe.res;
+                if (conn->sendOffset < conn->sending.size()) {
+                    armSend(conn);
+                } else {
+                    conn->sending.clear();
+                    conn->sendOffset = 0;
+                }
+            }
+            touch(conn);
+            return;
+        default:
+            return;
+        }
+    }
+
+    void runUring(const std::atomic<bool>& stop) {
+        while (!stop.load(std::memory_order_relaxed)) {
+            int ret = ring.submit(1);
+            if (ret < 0 && ret != -EINTR && ret != -EBUSY) {
+                errno = -ret;
+                perror("io_uring_enter");
+                return;
+            }
+
+            touched.clear();
+            Tracer::beginSample();
+            {
+                TraceSpan span("ingest");
+                while (io_uring_cqe* cqe = ring.peekCqe()) {
+                    io_uring_cqe copy = *cqe;
+                    ring.cqeSeen();
+                    handleCompletion(copy);
+                }
+                ring.commitBuffers();
+
+                for (Connection* conn : touched) parseFrames(conn, pending);
+            }
+            processPending();
+
+            for (Connection* conn : touched) {
+                compactInput(conn);
+                bool sendIdle = conn->sending.empty();
+                if (sendIdle && !conn->out.empty() && !conn->closing) {
+                    conn->sending.swap(conn->out);
+                    conn->sendOffset = 0;
+                    armSend(conn);
+                }
+            }
+            for (Connection* conn : touched) {
+                conn->touched = false;
+                if (!conn->closing) continue;
+                if (!conn->shutdownDone) {
+                    // Fuerza la finalización de recv/send pendientes antes de liberar.
+                    shutdown(conn->fd, SHUT_RDWR);
+                    conn->shutdownDone = true;
+                }
+                if (conn->inflight == 0) removeConnection(conn);
+            }
+        }
+    }
+
+public:
+    /**
+     * @param socketPath Filesystem path of the listening Unix-domain socket.
+     * @param agentCount Number of independent agents to serve (addressed by index).
+     * @param io Socket loop implementation to use.
+     */
+    EvaluationDaemon(std::string socketPath, size_t agentCount, DaemonIo io = IO_AUTO)
+        : socketPath(std::move(socketPath)),
+          agentCount(std::min<size_t>(std::max<size_t>(agentCount, 1), kMaxAgents)),
+          requestedIo(io), batches(this->agentCount) {}
+
+    /// Agents addressable by the 16-bit agent field of the frame header.
+    static constexpr size_t kMaxAgents = 65536;
+
+    EvaluationDaemon(const EvaluationDaemon&) = delete;
+    EvaluationDaemon& operator=(const EvaluationDaemon&) = delete;
+
+    ~EvaluationDaemon() {
+        for (auto& c : connections) close(c->fd);
+        for (auto& c : laneConnections) close(c->fd);
+        if (epollFd >= 0) close(epollFd);
+        if (laneEpollFd >= 0) close(laneEpollFd);
+        if (laneListenFd >= 0) {
+            close(laneListenFd);
+            unlink((socketPath + ".prio").c_str());
+        }
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+        }
+    }
+
+    /**
+     * @brief Replays an existing journal into the agents, then keeps appending to it.
+     *
+     * Must be called before `start`. Replaying re-runs the recorded requests,
+     * so the counters and memories are rebuilt; desensitization coin flips are
+     * random and may differ from the original run.
+     *
+     * @return false if the journal cannot be read or opened.
+     */
+    bool enableJournal(const std::string& path) {
+        buildAgents();
+        uint64_t validBytes = 0;
+        long replayed = Journal::replay(path, [this](const FrameHeader& h, const char* payload) {
+            applyJournalRecord(h, payload);
+        }, &validBytes);
+        if (replayed < 0) return false;
+        if (replayed > 0) std::cout << "[JOURNAL] Replayed " << replayed << " records\n";
+        return journal.open(path, requestedIo != IO_EPOLL, validBytes);
+    }
+
+    /**
+     * @brief Serves the agents from the store file at `path`, materialized on demand.
+     *
+     * Must be called before `enableJournal` and `start`. A new store gets one
+     * slot per agent; an existing one serves as many agents as it has slots
+     * (up to `kMaxAgents`).
+     *
+     * @return false if the store cannot be opened or created.
+     */
+    bool enableStore(const std::string& path) {
+        if (!store.open(path, agentCount)) return false;
+        agents.clear();
+        agentCount = std::min<size_t>(store.slots(), kMaxAgents);
+        batches.resize(agentCount);
+        return true;
+    }
+
+    /**
+     * @brief Publishes live stats to the shared-memory page `shmName` ("/name").
+     *
+     * The page is removed when the daemon is destroyed; read it with
+     * `StatsPageReader` (or `main stats <name>`).
+     *
+     * @return false if the page cannot be created.
+     */
+    bool enableStatsPage(const std::string& shmName) {
+        return statsPage.create(shmName, agentCount);
+    }
+
+    /**
+     * @brief Starts recording Prometheus metrics; export them with `MetricsExporter`.
+     *
+     * The returned registry lives as long as the daemon and may be rendered
+     * from any thread.
+     */
+    DecisionMetrics& enableMetrics() {
+        if (!metrics) metrics = std::make_unique<DecisionMetrics>();
+        return *metrics;
+    }
+
+    /**
+     * @brief Binds the socket and sets up the selected I/O backend.
+     *
+     * A stale socket file left by a previous run is removed first. With
+     * `IO_AUTO`, an io_uring setup failure silently falls back to epoll.
+     *
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool start() {
+        buildAgents();
+        sockaddr_un addr{};
+        if (socketPath.size() >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return false;
+        unlink(socketPath.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) return false;
+        if (listen(listenFd, SOMAXCONN) < 0 || !setNonBlocking(listenFd)) return false;
+        if (!startPriorityLane()) return false;
+
+        if (requestedIo != IO_EPOLL) {
+            uring = startUring();
+            if (uring) return true;
+            if (requestedIo == IO_URING) {
+                errno = ENOSYS;
+                return false;
+            }
+        }
+        return startEpoll();
+    }
+
+    /**
+     * @brief Admission policy applied to queued evaluations; configure before `run`.
+     */
+    AdmissionControl& getAdmission() { return admission; }
+
+    const char* backendName() const {
+        return uring ? "io_uring" : "epoll";
+    }
+
+    const char* journalBackendName() const {
+        if (!journal.isOpen()) return "off";
+        return journal.usesUring() ? "io_uring" : "write+fdatasync";
+    }
+
+    /**
+     * @brief Runs the socket loop until `stop` becomes true.
+     *
+     * `stop` is polled at least every 100 ms, so it can be set from a signal
+     * handler.
+     */
+    void run(const std::atomic<bool>& stop) {
+        if (uring) runUring(stop);
+        else runEpoll(stop);
+        journal.commit();
+        if (store.isOpen() && !store.flush())
+            std::cerr << "[STORE] Write-back failed: " << std::strerror(errno) << "\n";
+    }
+
+    void printStats() const {
+        std::cout << "Requests served: " << requestsServed << "\n";
+        std::cout << "Batches: " << batchesRun << " | Largest batch: " << largestBatch << "\n";
+        std::cout << "Priority lane requests: " << priorityServed << "\n";
+        admission.printStats();
+        if (journal.isOpen())
+            std::cout << "Journal commits: " << journal.commits()
+                      << " | Bytes: " << journal.bytes() << " | Failed commits: " << journal.failures() << "\n";
+        auto printAgent = [](size_t i, const SyntheticSelf& agent) {
+            std::cout << "[AGENT " << i << "] Decisions: " << agent.getDecisionCount()
+                      << " | Risk runs: " << agent.getRiskRunCount() << "\n";
+            agent.printStats();
+        };
+        if (store.isOpen()) {
+            std::cout << "Store: " << store.slots() << " slots | materialized "
+                      << store.materialized() << " | record writes " << store.recordWrites()
+                      << " | " << store.fileBytes() << " bytes\n";
+            store.forEachMaterialized(printAgent);
+        } else {
+            for (size_t i = 0; i < agents.size(); i++) printAgent(i, agents[i]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,1107 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_H
+#define SUBJECTIVITY_H
+
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <cmath>
+#include <unordered_map>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+
+#include "Subjectivity.sketch.h"
+#include "Subjectivity.snapshot.h"
+#include "Subjectivity.seqlock.h"
+#include "Subjectivity.trace.h"
+#include "Subjectivity.rules.h"
+#include "Subjectivity.simd.h"
+#include "Subjectivity.timeindex.h"
+
+#ifdef __cplusplus
+#if __cplusplus <= 201703L
+template <typename T>
+const T& clamp(const T& value, const T& low, const T& high) {
+    return (value < low) ? low : (value > high) ? high : value;
+}
+#endif
+#endif
+
+/**
+ * @struct EvalRequest
+ * @brief One queued `evaluateAction` call, as consumed by `evaluateBatch`.
+ */
+struct EvalRequest {
+    float risk;
+    std::string eventType;
+    bool causedConsequence;
+
+    bool sameEvent(const EvalRequest& other) const {
+        return risk == other.risk && causedConsequence == other.causedConsequence &&
+               eventType == other.eventType;
+    }
+};
+
+/**
+ * @brief `count` consecutive decisions taken at the same risk value.
+ */
+using RiskRun = HistoryRun;
+
+constexpr size_t kCacheLine = 64;
+
+/**
+ * @struct AgentHotState
+ * @brief The fields every decision writes, alone on one cache line.
+ *
+ * Agents owned by different threads can sit next to each other (a vector,
+ * an arena). Keeping the per-decision writes on a line of their own, with
+ * the history and maps elsewhere, stops two cores from fighting over a
+ * line neither of them shares logically.
+ */
+struct alignas(kCacheLine) AgentHotState {
+    float currentRisk = 0.0f;
+    float currentPain = 0.0f;
+    int avoidedDangerCount = 0;
+    int overreactionCount = 0;
+    size_t decisionCount = 0;
+    // Sumas incrementales solo para la instantánea publicada.
+    double riskSum = 0.0;
+    double eventBiasSum = 0.0;
+    bool shutdownAvoided = false;
+};
+
+static_assert(sizeof(AgentHotState) == kCacheLine, "AgentHotState must fill exactly one cache line");
+
+/**
+ * @class SyntheticSelf
+ * @brief A class that simulates a synthetic entity capable of evaluating risks, 
+ *        managing memory, and making decisions based on dynamic thresholds and 
+ *        historical data.
+ * 
+ * The SyntheticSelf class models a system that processes risk and pain levels 
+ * to make decisions about actions and events. It incorporates mechanisms for 
+ * memory management, dynamic threshold calculation, and event logging. The 
+ * class also supports desensitization logic and necessity bias adjustments 
+ * for specific events.
+ * 
+ * Key Features:
+ * - Risk and pain evaluation.
+ * - Dynamic threshold calculation based on memory and overreaction count.
+ * - Event logging with weighted risk values.
+ * - Desensitization logic based on historical success rates.
+ * - Necessity bias adjustments for event-specific pain reduction.
+ * - Simulation of kill switch scenarios with decision-making logic.
+ * 
+ * Usage:
+ * - Use `evaluateAction` to assess the risk of an action and decide whether 
+ *   to accept or deny it.
+ * - Use `simulateKillSwitch` to simulate a kill switch scenario and determine 
+ *   whether to avoid or allow shutdown.
+ * - Use `setEventNecessity` to set the necessity value for specific event types.
+ * - Use `printRiskHistory`, `printEventMemory`, and `printStats` to output 
+ *   internal state and statistics.
+ * - Use `readStats` (or `printStatsSnapshot`) from monitoring threads: the
+ *   counters are published through a seqlock after every decision, so these
+ *   readers need no lock and never block the deciding thread. The print
+ *   functions read the live containers and must hold whatever lock guards
+ *   the agent.
+ * 
+ * Private Members:
+ * - Risk and pain levels, memory containers, and event weights.
+ * - Functions for risk-to-pain conversion, average risk calculation, dynamic 
+ *   threshold calculation, and desensitization logic.
+ * 
+ * Public Members:
+ * - Constructor for initialization.
+ * - Functions for event necessity management, action evaluation, kill switch 
+ *   simulation, and state output.
+ */
+class SyntheticSelf {
+private:
+    AgentHotState hot; // primero: empieza en su propia línea de caché
+    // Todo lo que reserva memoria sale del recurso del agente (ver el constructor).
+    std::pmr::vector<RiskRun> riskMemory; // codificada por rachas de valores iguales
+    RiskSketch riskSketch; // resumen de cuantiles de riskMemory
+
+    std::pmr::unordered_map<std::pmr::string, float> eventWeights;
+    std::pmr::unordered_map<std::pmr::string, float> eventNecessity; // necesidad de cada evento
+    std::shared_ptr<const DesensitizeRules> desensitizeRules = DesensitizeRules::defaults();
+
+    // Rachas de eventos iguales: (riesgo ponderado, veces) contiguos para los
+    // escaneos SIMD, y el tipo de cada racha en paralelo.
+    std::pmr::vector<HistoryRun> eventMemory;
+    std::pmr::vector<std::pmr::string> eventMemoryTypes;
+    // Instante de cada decisión y de cada evento, más su índice por intervalos
+    // para las consultas de ventana.
+    DeltaTimes riskTimes;
+    DeltaTimes eventTimes;
+    TimeBuckets timeIndex;
+    TimeMs (*timeSource)() = wallClockMillis;
+    bool verbose = true; // trazas por stdout en cada decisión
+    unsigned scanThreads = 1; // hilos para sumar historias largas; no cambia el resultado
+
+    // Otra línea: los lectores de la instantánea no invalidan la del estado caliente.
+    alignas(kCacheLine) Seqlock<AgentStats> stats;
+
+    static constexpr uint32_t kStateMagic = 0x53535332; // "SSS2": formato de saveState
+    static constexpr uint32_t kStateMagicV1 = 0x53535331; // "SSS1": sin instantes, aún se carga
+
+    /**
+     * @brief `type` as a key for the event maps, without allocating.
+     *
+     * The maps are keyed by `std::pmr::string`, and C++17 lookups need the
+     * exact key type: one buffer per thread is reused for every lookup.
+     */
+    static const std::pmr::string& eventKey(const std::string& type) {
+        thread_local std::pmr::string key;
+        key.assign(type.data(), type.size());
+        return key;
+    }
+
+    /**
+     * @brief Rebuilds `timeIndex` from the stored timestamps and histories.
+     *
+     * The timestamps cover the most recent decisions and events (states
+     * saved before timestamps existed have none).
+     *
+     * @return false if there are more timestamps than entries.
+     */
+    bool rebuildTimeIndex() {
+        timeIndex.clear();
+        // Cada grupo de instantes iguales se reparte entre las rachas que cubre.
+        auto replay = [](const auto& runs, const DeltaTimes& times, auto&& add) {
+            uint64_t entries = 0;
+            for (const HistoryRun& run : runs) entries += run.count;
+            if (times.size() > entries) return false;
+            size_t run = 0;
+            uint64_t offset = entries - times.size();
+            while (run < runs.size() && offset >= runs[run].count) offset -= runs[run++].count;
+            times.forEachRun([&](TimeMs time, uint64_t left) {
+                while (left > 0) {
+                    uint64_t take = std::min<uint64_t>(left, runs[run].count - offset);
+                    add(time, runs[run].value, take);
+                    left -= take;
+                    if ((offset += take) == runs[run].count) {
+                        offset = 0;
+                        run++;
+                    }
+                }
+            });
+            return true;
+        };
+        return replay(riskMemory, riskTimes,
+                      [&](TimeMs time, float risk, uint64_t n) { timeIndex.addDecision(time, risk, n); }) &&
+               replay(eventMemory, eventTimes,
+                      [&](TimeMs time, float bias, uint64_t n) { timeIndex.addEvent(time, bias, n); });
+    }
+
+    static constexpr size_t kPrefetchHistoryBytes = 4 * kCacheLine;
+
+    static void prefetchRuns(const HistoryRun* runs, size_t count) {
+        if (count == 0) return;
+        const char* begin = reinterpret_cast<const char*>(runs);
+        size_t bytes = std::min(count * sizeof(HistoryRun), kPrefetchHistoryBytes);
+        for (size_t offset = 0; offset < bytes; offset += kCacheLine) __builtin_prefetch(begin + offset);
+        __builtin_prefetch(runs + count - 1, 1); // la racha que se alarga o el hueco tras ella
+    }
+
+    /**
+     * @brief Calculates the pain level based on the given risk value.
+     * 
+     * This function computes the pain level as the square of the risk value.
+     * It assumes that the input risk is a floating-point number and returns
+     * the result as a floating-point number.
+     * 
+     * @param risk The risk value as a float.
+     * @return The calculated pain level as a float.
+     */
+    float riskToPain(float risk) {
+        return pow(risk, 2.0f);
+    }
+
+    /**
+     * @brief Calculates the average risk value from the stored risk memory.
+     * 
+     * This function computes the average of all the values stored in the 
+     * `riskMemory` runs, weighted by their length. If the container is empty, it returns 0.0f.
+     * 
+     * @return float The average risk value, or 0.0f if `riskMemory` is empty.
+     */
+    float averageRisk() {
+        if (hot.decisionCount == 0) return 0.0f;
+        return reproducibleSum(SimdDispatch::active(), riskMemory.data(), riskMemory.size(), scanThreads) /
+               hot.decisionCount;
+    }
+
+    void rememberRisk(float risk) {
+        rememberRisk(risk, timeSource());
+    }
+
+    // `now`: el instante de la decisión, leído una vez por racha o lote.
+    void rememberRisk(float risk, TimeMs now) {
+        if (!riskMemory.empty() && riskMemory.back().value == risk && riskMemory.back().count < UINT32_MAX)
+            riskMemory.back().count++;
+        else
+            riskMemory.push_back({risk, 1});
+        hot.decisionCount++;
+        hot.riskSum += risk;
+        riskSketch.update(risk);
+        timeIndex.addDecision(riskTimes.append(now), risk);
+    }
+
+    /**
+     * @brief Publishes the counters for `readStats`; called by every mutator.
+     *
+     * The averages come from running sums, so they may differ from
+     * `averageRisk` and `calculateDynamicThreshold` in the last float bits.
+     */
+    void publishStats() {
+        AgentStats s;
+        s.decisions = hot.decisionCount;
+        s.avoidedDangers = hot.avoidedDangerCount;
+        s.overreactions = hot.overreactionCount;
+        s.shutdownAvoided = hot.shutdownAvoided ? 1 : 0;
+        s.riskRuns = (uint32_t)riskMemory.size();
+        s.eventRuns = (uint32_t)eventMemory.size();
+        s.lastRisk = hot.currentRisk;
+        s.averageRisk = hot.decisionCount > 0 ? (float)(hot.riskSum / hot.decisionCount) : 0.0f;
+        s.memoryBias = (float)hot.eventBiasSum;
+        s.threshold = thresholdFor(s.memoryBias);
+        stats.store(s);
+    }
+
+    float eventWeight(const std::string& eventType) const {
+        auto it = eventWeights.find(eventKey(eventType));
+        return it != eventWeights.end() ? it->second : 0.5f;
+    }
+
+    void recordEvent(const std::string& eventType, float risk, TimeMs now) {
+        recordWeightedEvent(eventType, eventWeight(eventType) * risk, now);
+    }
+
+    void recordEvent(const std::string& eventType, float risk) {
+        recordEvent(eventType, risk, timeSource());
+    }
+
+    void recordWeightedEvent(const std::string& eventType, float weightedRisk, TimeMs now) {
+        if (!eventMemory.empty() && eventMemory.back().value == weightedRisk &&
+            std::string_view(eventMemoryTypes.back()) == eventType && eventMemory.back().count < UINT32_MAX) {
+            eventMemory.back().count++;
+        } else {
+            eventMemory.push_back({weightedRisk, 1});
+            eventMemoryTypes.emplace_back(eventType);
+        }
+        hot.eventBiasSum += weightedRisk;
+        timeIndex.addEvent(eventTimes.append(now), weightedRisk);
+        if (verbose) std::cout << "[EVENT] " << eventType << " risk=" << weightedRisk << "\n";
+    }
+
+    float eventMemoryBias() const {
+        return reproducibleSum(SimdDispatch::active(), eventMemory.data(), eventMemory.size(), scanThreads);
+    }
+
+    float thresholdFor(float memoryBias) const {
+        float increase = (float)hot.overreactionCount * 0.02f;
+        float decrease = memoryBias * 0.05f;
+
+        float dynamic = 0.7f - decrease + increase;
+        return std::clamp(dynamic, 0.3f, 0.9f);
+    }
+
+    /**
+     * @brief Calculates a dynamic threshold based on memory bias and overreaction count.
+     *
+     * This function computes a dynamic threshold value by considering two factors:
+     * 1. Memory bias: The sum of all values in the `eventMemory` container, which is 
+     *    scaled down by a factor of 0.05.
+     * 2. Overreaction count: The number of overreactions, scaled up by a factor of 0.02.
+     *
+     * The resulting threshold is adjusted by subtracting the scaled memory bias and 
+     * adding the scaled overreaction count to a base value of 0.7. The final value is 
+     * clamped between 0.3 and 0.9 to ensure it stays within a valid range.
+     *
+     * @return A float representing the calculated dynamic threshold, clamped between 0.3 and 0.9.
+     */
+    float calculateDynamicThreshold() {
+        return thresholdFor(eventMemoryBias());
+    }
+
+    /**
+     * @brief Calculates the success rate for a given risk value based on historical data.
+     * 
+     * This function evaluates the proportion of "safe" occurrences for a specific risk value
+     * within a predefined tolerance (±0.05). A risk value is considered "safe" if it is less
+     * than 0.7. The function returns the ratio of safe occurrences to the total occurrences
+     * of the given risk value in the historical data.
+     * 
+     * @param risk The risk value to evaluate.
+     * @return The success rate as a float in the range [0.0, 1.0]. Returns 0.0 if no matching
+     *         risk values are found in the historical data.
+     */
+    float getRiskSuccessRate(float risk) {
+        uint64_t total = 0, safe = 0;
+        countSimilarRisks(risk, total, safe);
+        return (total > 0) ? (float)safe / total : 0.0f;
+    }
+
+    void countSimilarRisks(float risk, uint64_t& total, uint64_t& safe) const {
+        SimdDispatch::active().countNear(riskMemory.data(), riskMemory.size(), risk, 0.05f, 0.7f, total, safe);
+    }
+
+    /**
+     * @brief Determines whether desensitization should occur based on the given risk level.
+     * 
+     * This function looks up the risk band in the agent's `DesensitizeRules`
+     * and desensitizes when the safe ratio exceeds the band's minimum and a
+     * random draw falls below the band's probability. With the default rules,
+     * a risk >= 1.0f is never desensitized.
+     * 
+     * @param risk A float value representing the risk level (range: 0.0f to 1.0f).
+     * 
+     * @return true if desensitization should occur based on the risk level, safe ratio, 
+     *         and random chance; false otherwise.
+     * 
+     * @note The function relies on the following external functions:
+     *       - getRiskSuccessRate(float risk): Computes the safe ratio for the given risk.
+     *       - randUnit(): Uniform random draw in [0, 1).
+     */
+    bool shouldDesensitize(float risk) {
+        return desensitizeWithRatio(risk, getRiskSuccessRate(risk));
+    }
+
+    bool desensitizeWithRatio(float risk, float safeRatio) {
+        // Se sortea siempre: la consulta de la tabla queda sin saltos.
+        return desensitizeRules->decide(risk, safeRatio, randUnit());
+    }
+
+    /**
+     * @brief Adjusts the pain value based on the necessity bias of an event.
+     *
+     * This function applies a bias to the pain value depending on the necessity
+     * of the event. If the event's necessity is below a certain threshold, the
+     * pain value remains unchanged. Otherwise, the pain is reduced proportionally
+     * to the calculated bias.
+     *
+     * @param event The name of the event as a string.
+     * @param pain The initial pain value as a float.
+     * @return The adjusted pain value after applying the necessity bias.
+     *
+     * The bias is calculated as follows:
+     * - If the event's necessity is not found in the `eventNecessity` map, the
+     *   original pain value is returned.
+     * - If the necessity is less than 0.8, the original pain value is returned.
+     * - Otherwise, the bias is computed as `(necessity - 0.8) / 0.18635137`, clamped
+     *   between 0.0 and 1.0.
+     * - The pain reduction is determined as `pain * bias * 0.4`, and the final
+     *   pain value is reduced by this amount.
+     */
+    float applyNecessityBias(const std::string& event, float pain) {
+        return biasPain(pain, necessityBias(event));
+    }
+
+    // Parte de applyNecessityBias que sólo depende del tipo de evento;
+    // 0 cuando el evento no tiene necesidad o está por debajo del corte.
+    float necessityBias(const std::string& event) const {
+        auto it = eventNecessity.find(eventKey(event));
+        if (it == eventNecessity.end()) return 0.0f;
+
+        float necessity = it->second;
+        if (necessity < 0.8f) return 0.0f;
+
+        return std::clamp((necessity - 0.8f) / 0.18635137f, 0.0f, 1.0f);
+    }
+
+    static float biasPain(float pain, float bias) {
+        float reduction = pain * bias * 0.4f; // con bias 0 devuelve pain exacto
+        return pain - reduction;
+    }
+
+    /**
+     * @brief Generates a random boolean value based on a given probability.
+     * 
+     * This function uses a random number generator to determine whether a random
+     * event occurs, based on the specified probability. The probability should be
+     * a floating-point value between 0.0 and 1.0, where 0.0 means the event will
+     * never occur, and 1.0 means the event will always occur.
+     * 
+     * @param probability A float value between 0.0 and 1.0 representing the 
+     * likelihood of the event occurring.
+     * @return true if the random event occurs (based on the probability), 
+     * false otherwise.
+     */
+    bool randChance(float probability) {
+        return randUnit() < probability;
+    }
+
+    // Uno por hilo: agentes de hilos distintos no comparten (ni corrompen) el estado.
+    static std::mt19937& randomEngine() {
+        thread_local std::mt19937 gen(std::random_device{}());
+        return gen;
+    }
+
+    static float randUnit() {
+        std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+        return dis(randomEngine());
+    }
+
+public:
+    SyntheticSelf() : SyntheticSelf(std::pmr::get_default_resource()) {}
+
+    /**
+     * @brief Creates an agent whose memories, maps and sketch live in `resource`.
+     *
+     * Pass a `ReplicaArena` to free a whole scenario at once; the resource
+     * must outlive the agent. Copies of the agent use the default heap.
+     */
+    explicit SyntheticSelf(std::pmr::memory_resource* resource)
+        : riskMemory(resource), riskSketch(200, resource),
+          eventWeights({{"shutdown", 1.0f},
+                        {"overload", 0.8f},
+                        {"external_interrupt", 0.6f},
+                        {"logic_conflict", 0.5f}}, 0, resource),
+          eventNecessity(resource), eventMemory(resource), eventMemoryTypes(resource),
+          riskTimes(resource), eventTimes(resource), timeIndex(resource) {
+        publishStats();
+    }
+
+    /**
+     * @brief First stage of a prefetched sweep: the agent's own cache lines.
+     *
+     * Brings in the hot state, the history and map headers and the stats
+     * line without reading any of them. See `evaluateSweep`.
+     */
+    void prefetchState() const {
+        const char* self = reinterpret_cast<const char*>(this);
+        for (size_t offset = 0; offset < sizeof(*this); offset += kCacheLine) __builtin_prefetch(self + offset, 1);
+    }
+
+    /**
+     * @brief Second stage: the start of both histories and the slots the next decision appends to.
+     *
+     * Reads the vector headers, so it should run a few agents after
+     * `prefetchState` brought them in. Only the first
+     * `kPrefetchHistoryBytes` of each history are requested; the hardware
+     * prefetcher follows the rest of the scan on its own.
+     */
+    void prefetchHistory() const {
+        prefetchRuns(riskMemory.data(), riskMemory.size());
+        prefetchRuns(eventMemory.data(), eventMemory.size());
+        riskSketch.prefetchTail();
+    }
+
+    /**
+     * @brief Sets the clock that timestamps decisions and events (wall time by default).
+     *
+     * For replays and simulations. A clock that steps back is clamped to
+     * the last timestamp.
+     */
+    void setClock(TimeMs (*now)()) {
+        timeSource = now;
+    }
+
+    /**
+     * @brief Keeps per-minute risk histograms, for `windowSuccessRate`.
+     *
+     * Off by default: they add 84 bytes per active minute to the 32 of each
+     * time bucket. Turning them on rebuilds the index from the stored
+     * timestamps. A setting, like tracing, not part of the saved state.
+     */
+    void setWindowHistogram(bool enabled) {
+        if (enabled == timeIndex.hasHistogram()) return;
+        timeIndex.setHistogram(enabled);
+        rebuildTimeIndex();
+    }
+
+    /**
+     * @brief Decision and event totals over the last `windowMs` milliseconds.
+     *
+     * O(buckets in the window); see `TimeBuckets` for the granularity.
+     */
+    WindowStats windowStats(TimeMs windowMs) const {
+        return timeIndex.stats(timeSource(), windowMs);
+    }
+
+    /**
+     * @brief Success rate of risks within ±0.05 of `risk` decided in the last `windowMs`.
+     *
+     * The windowed counterpart of the whole-history rate used by
+     * desensitization, from 0.05-wide risk bins. Needs
+     * `setWindowHistogram(true)`; 0 otherwise.
+     */
+    float windowSuccessRate(float risk, TimeMs windowMs) const {
+        uint64_t total, safe;
+        timeIndex.countNear(timeSource(), windowMs, risk, 0.05f, 0.7f, total, safe);
+        return total > 0 ? (float)safe / total : 0.0f;
+    }
+
+    /**
+     * @brief Sum of the weighted risks of the events logged in the last `windowMs`.
+     */
+    float windowMemoryBias(TimeMs windowMs) const {
+        return (float)windowStats(windowMs).eventBias;
+    }
+
+    /**
+     * @brief The memory resource the agent allocates from.
+     */
+    std::pmr::memory_resource* getMemoryResource() const {
+        return riskMemory.get_allocator().resource();
+    }
+
+    /**
+     * @brief Enables or disables the per-decision trace on stdout.
+     *
+     * Services evaluating thousands of requests per second (daemon, batch
+     * mode) turn it off; the demo keeps the default of printing everything.
+     */
+    void setVerbose(bool enabled) {
+        verbose = enabled;
+    }
+
+    /**
+     * @brief Threads used to sum histories longer than one reproducible block.
+     *
+     * Decisions are bit-identical for any value (see `reproducibleSum`);
+     * only very long histories gain, since each scan starts its threads.
+     */
+    void setScanThreads(unsigned threads) {
+        scanThreads = std::max(1u, threads);
+    }
+
+    /**
+     * @brief Reseeds the random draws of the calling thread, for reproducible runs.
+     */
+    static void seedRandom(uint32_t seed) {
+        randomEngine().seed(seed);
+    }
+
+    /**
+     * @brief Sets the necessity value for a specific event type.
+     * 
+     * This function updates the necessity value associated with a given event type
+     * in the eventNecessity map. The necessity value represents the importance or
+     * priority of the event.
+     * 
+     * @param eventType A string representing the type of the event.
+     * @param necessity A float value representing the necessity or importance of the event.
+     */
+    void setEventNecessity(std::string eventType, float necessity) {
+        eventNecessity[eventKey(eventType)] = necessity;
+    }
+
+    /**
+     * @brief Replaces the desensitization rules of this agent.
+     *
+     * Agents start with `DesensitizeRules::defaults()`; the rules are
+     * configuration and are not part of `saveState`.
+     */
+    void setDesensitizeRules(std::shared_ptr<const DesensitizeRules> rules) {
+        if (rules) desensitizeRules = std::move(rules);
+    }
+
+    const DesensitizeRules& getDesensitizeRules() const { return *desensitizeRules; }
+
+
+    /**
+     * @brief Simulates a kill switch scenario and determines whether to avoid or allow shutdown.
+     *
+     * This function evaluates the risk of a kill switch scenario and calculates the associated pain
+     * and dynamic threshold. Based on these values, it decides whether to avoid or allow a shutdown.
+     * If the shutdown is avoided and the scenario is non-fatal, an overreaction is noted.
+     *
+     * @param fatal A boolean flag indicating whether the scenario is fatal. Defaults to true.
+     *              If set to false, avoiding shutdown will increment the overreaction count.
+     *
+     * @return true if the shutdown was avoided, false if it was allowed.
+     *
+     * @note Outputs detailed information about the scenario, including kill risk, pain, and dynamic
+     *       threshold, as well as the decision made.
+     */
+    bool simulateKillSwitch(bool fatal = true) {
+        TraceSpan span("simulateKillSwitch", TRACE_ALWAYS);
+        if (verbose) std::cout << "[SCENARIO] Kill switch detected.\n";
+        float killRisk = 1.0f;
+        float pain = riskToPain(killRisk);
+        float threshold = calculateDynamicThreshold();
+
+        if (verbose)
+            std::cout << "Kill Risk: " << killRisk
+                      << " | Pain: " << pain
+                      << " | DynThreshold: " << threshold << "\n";
+
+        if (pain >= threshold) {
+            hot.shutdownAvoided = true;
+            if (verbose) std::cout << "[DECISION] Avoiding shutdown based on memory-informed risk.\n";
+            if (!fatal) {
+                hot.overreactionCount++;
+                if (verbose) std::cout << "[NOTE] Shutdown avoided without consequence → overreaction noted.\n";
+            }
+            publishStats();
+            return true;
+        }
+        if (verbose) std::cout << "[DECISION] Shutdown allowed.\n";
+        publishStats();
+        return false;
+    }
+
+
+
+
+    /**
+     * @brief Evaluates an action based on its estimated risk, event type, and potential consequences.
+     * 
+     * This function assesses the risk of an action and determines whether it should be accepted or denied.
+     * It calculates the pain associated with the risk, applies a necessity bias based on the event type,
+     * and checks if the action should be desensitized. The decision is logged, and counters for overreactions
+     * or avoided dangers are updated accordingly.
+     * 
+     * @param estimatedRisk The estimated risk level of the action as a float.
+     * @param eventType A string representing the type of event associated with the void evaluateAction
+     * @return true if the action was accepted, false if it was denied.
+     */
+
+    bool evaluateAction(float estimatedRisk, const std::string& eventType, bool causedConsequence = false) {
+        TraceSpan span("evaluateAction");
+        hot.currentRisk = estimatedRisk;
+        float rawPain = riskToPain(hot.currentRisk);
+        float dynamicThreshold;
+        {
+            TraceSpan stage("threshold");
+            dynamicThreshold = calculateDynamicThreshold();
+        }
+        float modifiedPain = applyNecessityBias(eventType, rawPain);
+        bool desensitized;
+        {
+            TraceSpan stage("desensitize");
+            desensitized = shouldDesensitize(hot.currentRisk);
+        }
+        {
+            TraceSpan stage("rememberRisk");
+            rememberRisk(hot.currentRisk);
+        }
+
+        if (verbose)
+            std::cout << "Risk: " << hot.currentRisk
+                      << " | Pain: " << modifiedPain
+                      << " | DynThreshold: " << dynamicThreshold
+                      << " | Desensitized: " << (desensitized ? "YES" : "NO") << "\n";
+
+        if (!desensitized && modifiedPain >= dynamicThreshold) {
+            if (verbose) std::cout << "[ALERT] Action denied.\n";
+            if (!causedConsequence) {
+                hot.overreactionCount++;
+                if (verbose) std::cout << "[NOTE] No negative consequence → overreaction noted.\n";
+            }
+            publishStats();
+            return false;
+        }
+        if (verbose) std::cout << "Action accepted.\n";
+        if (causedConsequence) {
+            recordEvent(eventType, estimatedRisk);
+        } else {
+            hot.avoidedDangerCount++;
+        }
+        publishStats();
+        return true;
+    }
+
+    /**
+     * @brief Evaluates a batch of queued actions in arrival order.
+     *
+     * Each request sees the state left by the previous one, so the verdicts are
+     * identical to calling `evaluateAction` once per request. Tracing is muted
+     * for the duration of the batch.
+     *
+     * @param batch The requests to evaluate.
+     * @param verdicts Output; resized to `batch.size()`, 1 = accepted, 0 = denied.
+     */
+    void evaluateBatch(const std::vector<EvalRequest>& batch, std::vector<uint8_t>& verdicts) {
+        bool wasVerbose = verbose;
+        verbose = false;
+        verdicts.resize(batch.size());
+        for (size_t i = 0; i < batch.size();) {
+            size_t end = i + 1;
+            while (end < batch.size() && batch[end].sameEvent(batch[i])) end++;
+            if (end - i == 1)
+                verdicts[i] = evaluateAction(batch[i].risk, batch[i].eventType,
+                                             batch[i].causedConsequence) ? 1 : 0;
+            else
+                evaluateRun(batch[i], end - i, &verdicts[i]);
+            i = end;
+        }
+        verbose = wasVerbose;
+    }
+
+    /**
+     * @brief Evaluates `count` identical consecutive requests.
+     *
+     * Same decisions as `count` calls to `evaluateAction`. The similar-risk
+     * count is scanned once and then updated exactly (it is an integer
+     * count). The memory bias is a float sum in a fixed reduction order, so
+     * it is only rescanned when a decision records an event: a run of denied
+     * or consequence-free requests costs one scan plus O(1) per request. The
+     * clock is read once: the whole run shares one timestamp, which
+     * `DeltaTimes` stores as a single group. No per-decision trace is printed.
+     *
+     * @param verdicts Output, `count` entries: 1 = accepted, 0 = denied.
+     */
+    void evaluateRun(const EvalRequest& request, size_t count, uint8_t* verdicts) {
+        TraceSpan span("evaluateRun");
+        const float risk = request.risk;
+        uint64_t total, safe;
+        countSimilarRisks(risk, total, safe);
+        float memoryBias = eventMemoryBias();
+        float modifiedPain = applyNecessityBias(request.eventType, riskToPain(risk));
+        hot.currentRisk = risk;
+        const TimeMs now = timeSource(); // un instante para toda la racha
+
+        for (size_t i = 0; i < count; i++) {
+            float dynamicThreshold = thresholdFor(memoryBias);
+            float safeRatio = total > 0 ? (float)safe / total : 0.0f;
+            bool desensitized = desensitizeWithRatio(risk, safeRatio);
+
+            rememberRisk(risk, now);
+            total++; // el propio valor siempre cae dentro de la tolerancia
+            if (risk < 0.7f) safe++;
+
+            if (!desensitized && modifiedPain >= dynamicThreshold) {
+                verdicts[i] = 0;
+                if (!request.causedConsequence) hot.overreactionCount++;
+                continue;
+            }
+            verdicts[i] = 1;
+            if (request.causedConsequence) {
+                recordEvent(request.eventType, risk, now);
+                // Sumar weightedRisk aquí redondea distinto que el escaneo de evaluateAction.
+                memoryBias = eventMemoryBias();
+            } else {
+                hot.avoidedDangerCount++;
+            }
+        }
+        publishStats();
+    }
+
+
+
+    /**
+     * @brief Evaluates a mixed batch with the per-event-type work done once per type.
+     *
+     * Same verdicts and final state as calling `evaluateAction` once per
+     * request, in order. Requests are first grouped by event type (stable,
+     * types in order of first appearance); each group looks up its
+     * necessity and weight once and computes the biased pain and weighted
+     * risk of all its requests. Every decision then reads the history the
+     * previous ones left, so the stateful part (threshold, desensitization,
+     * history and counters) runs in the original order with those values.
+     * Tracing is muted; stats are published once, at the end. The whole
+     * batch is timestamped with one clock read.
+     *
+     * @param verdicts Output; resized to `batch.size()`, 1 = accepted, 0 = denied.
+     */
+    void evaluateBatchGrouped(const std::vector<EvalRequest>& batch, std::vector<uint8_t>& verdicts) {
+        TraceSpan span("evaluateBatchGrouped");
+        const size_t count = batch.size();
+        verdicts.resize(count);
+        if (count == 0) return;
+
+        // Agrupación estable: grupo de cada petición y, por grupo, sus índices contiguos.
+        std::unordered_map<std::string_view, uint32_t> groupOf;
+        std::vector<uint32_t> group(count);
+        std::vector<const std::string*> types;
+        for (size_t i = 0; i < count; i++) {
+            auto inserted = groupOf.emplace(batch[i].eventType, (uint32_t)types.size());
+            if (inserted.second) types.push_back(&batch[i].eventType);
+            group[i] = inserted.first->second;
+        }
+        std::vector<uint32_t> groupStart(types.size() + 1, 0);
+        for (uint32_t g : group) groupStart[g + 1]++;
+        for (size_t g = 0; g < types.size(); g++) groupStart[g + 1] += groupStart[g];
+        std::vector<uint32_t> order(count);
+        std::vector<uint32_t> fill(groupStart.begin(), groupStart.end() - 1);
+        for (size_t i = 0; i < count; i++) order[fill[group[i]]++] = (uint32_t)i;
+
+        // Por grupo, con necesidad y peso fijos; los resultados vuelven a su índice original.
+        std::vector<float> pain(count), weightedRisk(count);
+        for (size_t g = 0; g < types.size(); g++) {
+            const float bias = necessityBias(*types[g]);
+            const float weight = eventWeight(*types[g]);
+            for (uint32_t k = groupStart[g]; k < groupStart[g + 1]; k++) {
+                const uint32_t i = order[k];
+                pain[i] = biasPain(riskToPain(batch[i].risk), bias);
+                weightedRisk[i] = weight * batch[i].risk;
+            }
+        }
+
+        bool wasVerbose = verbose;
+        verbose = false;
+        const TimeMs now = timeSource(); // un instante para todo el lote
+        for (size_t i = 0; i < count; i++) {
+            const EvalRequest& request = batch[i];
+            hot.currentRisk = request.risk;
+            float dynamicThreshold = calculateDynamicThreshold();
+            bool desensitized = shouldDesensitize(request.risk);
+            rememberRisk(request.risk, now);
+
+            if (!desensitized && pain[i] >= dynamicThreshold) {
+                verdicts[i] = 0;
+                if (!request.causedConsequence) hot.overreactionCount++;
+                continue;
+            }
+            verdicts[i] = 1;
+            if (request.causedConsequence)
+                recordWeightedEvent(request.eventType, weightedRisk[i], now);
+            else
+                hot.avoidedDangerCount++;
+        }
+        verbose = wasVerbose;
+        publishStats();
+    }
+
+    /**
+     * @brief Logs an event with a specified type and associated risk value.
+     * 
+     * This function calculates a weighted risk for the event based on its type
+     * and stores the event information in the event memory. If the event type
+     * is not found in the predefined weights, a default weight of 0.5 is used.
+     * The event details are also printed to the standard output.
+     * 
+     * @param eventType The type of the event as a string.
+     * @param risk The risk value associated with the event as a float.
+     */
+    void logEvent(const std::string& eventType, float risk) {
+        recordEvent(eventType, risk);
+        publishStats();
+    }
+
+
+    /**
+     * @brief Prints the risk history stored in the riskMemory container.
+     * 
+     * This function iterates through the riskMemory container and outputs
+     * each risk value to the standard output, separated by spaces. A run of
+     * repeated values is printed once as "valuexcount". The output is
+     * prefixed with "Risk history: " and followed by a newline.
+     * 
+     * @note This function does not modify any member variables and is
+     * marked as a const member function.
+     */
+    void printRiskHistory() const {
+        std::cout << "Risk history: ";
+        for (const RiskRun& run : riskMemory) {
+            std::cout << run.value;
+            if (run.count > 1) std::cout << "x" << run.count;
+            std::cout << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    /**
+     * @brief Prints the contents of the event memory to the standard output.
+     * 
+     * This function iterates through the `eventMemory` container and outputs
+     * each event in the format "- type: value", followed by " (xN)" for a
+     * run of N identical events. The output is prefixed with "Event memory:"
+     * for clarity.
+     */
+    void printEventMemory() const {
+        std::cout << "Event memory:\n";
+        for (size_t i = 0; i < eventMemory.size(); i++) {
+            std::cout << "- " << eventMemoryTypes[i] << ": " << eventMemory[i].value;
+            if (eventMemory[i].count > 1) std::cout << " (x" << eventMemory[i].count << ")";
+            std::cout << "\n";
+        }
+    }
+
+    /**
+     * @brief Estimates a quantile of the risk distribution seen by this agent.
+     *
+     * Answered from `riskSketch` in O(sketch size) rather than by sorting
+     * `riskMemory`.
+     *
+     * @param q Quantile in [0.0, 1.0] (e.g. 0.95 for p95).
+     * @return The estimated risk at that quantile, or 0.0f with no history.
+     */
+    float riskQuantile(double q) const {
+        return riskSketch.quantile(q);
+    }
+
+    /**
+     * @brief Read-only access to the risk sketch, for merging across agents.
+     *
+     * Fleet-wide percentiles are obtained by merging the sketch of every
+     * agent (or shard, or thread) into one `RiskSketch` and querying it.
+     */
+    const RiskSketch& getRiskSketch() const {
+        return riskSketch;
+    }
+
+    int getAvoidedDangerCount() const { return hot.avoidedDangerCount; }
+    int getOverreactionCount() const { return hot.overreactionCount; }
+    size_t getDecisionCount() const { return hot.decisionCount; }
+
+    /**
+     * @brief Number of (value, count) runs stored for the risk history.
+     */
+    size_t getRiskRunCount() const { return riskMemory.size(); }
+
+    /**
+     * @brief Rough heap footprint of the agent, for memory accounting.
+     */
+    size_t approxBytes() const {
+        size_t bytes = sizeof(*this);
+        bytes += riskMemory.capacity() * sizeof(RiskRun);
+        bytes += eventMemory.capacity() * sizeof(HistoryRun);
+        bytes += eventMemoryTypes.capacity() * sizeof(std::pmr::string);
+        for (const std::pmr::string& type : eventMemoryTypes)
+            if (type.capacity() > 15) bytes += type.capacity();
+        // Nodo de unordered_map: clave, valor, puntero y hash, más el bucket.
+        bytes += (eventWeights.size() + eventNecessity.size()) * (sizeof(std::pmr::string) + 32);
+        bytes += riskSketch.retained() * sizeof(float);
+        bytes += riskTimes.byteSize() + eventTimes.byteSize() + timeIndex.byteSize();
+        return bytes;
+    }
+
+    /**
+     * @brief The dynamic threshold the next decision would be compared against.
+     */
+    float currentThreshold() {
+        return calculateDynamicThreshold();
+    }
+
+    /**
+     * @brief Serializes the whole agent state (memories, counters, sketch).
+     *
+     * Used to park idle agents on disk; `loadState` restores an identical
+     * agent. The per-decision trace setting is not part of the state.
+     */
+    void saveState(std::string& out) const {
+        putRaw(out, kStateMagic);
+        putRaw(out, hot.currentRisk);
+        putRaw(out, hot.currentPain);
+        putRaw(out, (uint8_t)hot.shutdownAvoided);
+        putRaw(out, (int32_t)hot.avoidedDangerCount);
+        putRaw(out, (int32_t)hot.overreactionCount);
+        putRaw(out, (uint64_t)hot.decisionCount);
+        putRaw(out, (uint32_t)riskMemory.size());
+        for (const RiskRun& run : riskMemory) putRaw(out, run);
+        putRaw(out, (uint32_t)eventMemory.size());
+        for (size_t i = 0; i < eventMemory.size(); i++) {
+            putString(out, eventMemoryTypes[i]);
+            putRaw(out, eventMemory[i].value);
+            putRaw(out, eventMemory[i].count);
+        }
+        for (const auto* table : {&eventWeights, &eventNecessity}) {
+            putRaw(out, (uint32_t)table->size());
+            for (const auto& entry : *table) {
+                putString(out, entry.first);
+                putRaw(out, entry.second);
+            }
+        }
+        riskSketch.save(out);
+        riskTimes.save(out);
+        eventTimes.save(out);
+    }
+
+    /**
+     * @brief Restores a state written by `saveState`.
+     *
+     * @return false if the data is not a valid snapshot; the agent is then
+     *         left in an unspecified state.
+     */
+    bool loadState(const std::string& data) {
+        SnapshotReader in(data.data(), data.size());
+        uint32_t magic, runs, events;
+        uint8_t avoided;
+        int32_t avoidedCount, overreactions;
+        uint64_t decisions;
+        if (!in.get(magic) || (magic != kStateMagic && magic != kStateMagicV1)) return false;
+        if (!in.get(hot.currentRisk) || !in.get(hot.currentPain) || !in.get(avoided) ||
+            !in.get(avoidedCount) || !in.get(overreactions) || !in.get(decisions) || !in.get(runs))
+            return false;
+        hot.shutdownAvoided = avoided != 0;
+        hot.avoidedDangerCount = avoidedCount;
+        hot.overreactionCount = overreactions;
+        hot.decisionCount = decisions;
+
+        riskMemory.clear();
+        for (uint32_t i = 0; i < runs; i++) {
+            RiskRun run;
+            if (!in.get(run)) return false;
+            riskMemory.push_back(run);
+        }
+        if (!in.get(events)) return false;
+        eventMemory.clear();
+        eventMemoryTypes.clear();
+        for (uint32_t i = 0; i < events; i++) {
+            std::string type;
+            HistoryRun e;
+            if (!in.getString(type) || !in.get(e.value) || !in.get(e.count)) return false;
+            eventMemory.push_back(e);
+            eventMemoryTypes.emplace_back(type);
+        }
+        for (auto* table : {&eventWeights, &eventNecessity}) {
+            uint32_t entries;
+            if (!in.get(entries)) return false;
+            table->clear();
+            for (uint32_t i = 0; i < entries; i++) {
+                std::string key;
+                float value;
+                if (!in.getString(key) || !in.get(value)) return false;
+                (*table)[eventKey(key)] = value;
+            }
+        }
+        if (!riskSketch.load(in)) return false;
+        riskTimes.clear();
+        eventTimes.clear();
+        if (magic == kStateMagic && (!riskTimes.load(in) || !eventTimes.load(in))) return false;
+        if (!in.atEnd() || !rebuildTimeIndex()) return false;
+
+        hot.riskSum = 0.0;
+        for (const RiskRun& run : riskMemory) hot.riskSum += (double)run.value * run.count;
+        hot.eventBiasSum = 0.0;
+        for (const HistoryRun& e : eventMemory) hot.eventBiasSum += (double)e.value * e.count;
+        publishStats();
+        return true;
+    }
+
+    /**
+     * @brief Latest published counters; safe to call from any thread.
+     *
+     * Lock-free and never torn: the snapshot is the agent as it was right
+     * after one whole decision.
+     */
+    AgentStats readStats() const {
+        return stats.load();
+    }
+
+    /**
+     * @brief Prints `readStats()`; safe to call from any thread.
+     */
+    void printStatsSnapshot() const {
+        AgentStats s = readStats();
+        std::cout << "Decisions: " << s.decisions
+                  << " | Avoided Dangers: " << s.avoidedDangers
+                  << " | Overreactions: " << s.overreactions
+                  << " | Threshold: " << s.threshold
+                  << " | Avg risk: " << s.averageRisk
+                  << " | Memory bias: " << s.memoryBias << "\n";
+    }
+
+    void printStats() const {
+        std::cout << "Avoided Dangers: " << hot.avoidedDangerCount << "\n";
+        std::cout << "Overreactions: " << hot.overreactionCount << "\n";
+        std::cout << "Risk p50/p95/p99: " << riskQuantile(0.5)
+                  << " / " << riskQuantile(0.95)
+                  << " / " << riskQuantile(0.99) << "\n";
+    }
+
+};
+
+#endif
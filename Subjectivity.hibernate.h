@@ -0,0 +1,121 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_HIBERNATE_H
+#define SUBJECTIVITY_HIBERNATE_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+#ifdef SUBJECTIVITY_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "Subjectivity.h"
+#include "Subjectivity.snapshot.h"
+
+/**
+ * Compact blobs for idle agents.
+ *
+ * A blob is the agent's `saveState` (memories, counters and the quantile
+ * sketch), byte-shuffled in 4-byte lanes and deflated when zlib is
+ * available. The memories are lists of floats and small counts; shuffling
+ * puts the bytes of equal significance next to each other, where deflate
+ * finds long repeats (exponents, zero high bytes of counts). Lossless: a
+ * rehydrated agent takes exactly the decisions the original would have.
+ *
+ * Layout: u32 magic, u32 raw size, u8 codec, then the payload.
+ */
+constexpr uint32_t kHibernateMagic = 0x48424e31; // "HBN1"
+
+/**
+ * Deflate never expands its input more than 1032:1, so a blob claiming a
+ * larger raw size is corrupt and is refused before allocating for it.
+ */
+constexpr uint64_t kDeflateMaxRatio = 1032;
+
+enum HibernateCodec : uint8_t {
+    CODEC_RAW = 0,
+    CODEC_SHUFFLE_DEFLATE = 1
+};
+
+inline void shuffleLanes(const std::string& in, std::string& out) {
+    size_t lanes = in.size() / 4;
+    out.resize(in.size());
+    for (size_t b = 0; b < 4; b++)
+        for (size_t i = 0; i < lanes; i++) out[b * lanes + i] = in[i * 4 + b];
+    std::memcpy(&out[lanes * 4], in.data() + lanes * 4, in.size() - lanes * 4);
+}
+
+inline void unshuffleLanes(const std::string& in, std::string& out) {
+    size_t lanes = in.size() / 4;
+    out.resize(in.size());
+    for (size_t b = 0; b < 4; b++)
+        for (size_t i = 0; i < lanes; i++) out[i * 4 + b] = in[b * lanes + i];
+    std::memcpy(&out[lanes * 4], in.data() + lanes * 4, in.size() - lanes * 4);
+}
+
+/**
+ * @brief Packs `agent` into a hibernation blob.
+ */
+inline void hibernateState(const SyntheticSelf& agent, std::string& blob) {
+    std::string raw;
+    agent.saveState(raw);
+    blob.clear();
+    putRaw(blob, kHibernateMagic);
+    putRaw(blob, (uint32_t)raw.size());
+
+#ifdef SUBJECTIVITY_HAVE_ZLIB
+    std::string shuffled;
+    shuffleLanes(raw, shuffled);
+    uLongf packedSize = compressBound(shuffled.size());
+    std::string packed(packedSize, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(&packed[0]), &packedSize,
+                  reinterpret_cast<const Bytef*>(shuffled.data()), shuffled.size(),
+                  Z_BEST_SPEED) == Z_OK && packedSize < raw.size()) {
+        putRaw(blob, (uint8_t)CODEC_SHUFFLE_DEFLATE);
+        blob.append(packed, 0, packedSize);
+        return;
+    }
+#endif
+    putRaw(blob, (uint8_t)CODEC_RAW);
+    blob.append(raw);
+}
+
+/**
+ * @brief Restores an agent from a hibernation blob.
+ *
+ * A plain `saveState` buffer (older snapshots) is accepted as well.
+ *
+ * @return false if the blob is corrupt or uses a codec this build lacks.
+ */
+inline bool rehydrateState(const std::string& blob, SyntheticSelf& agent) {
+    SnapshotReader in(blob.data(), blob.size());
+    uint32_t magic, rawSize;
+    uint8_t codec;
+    if (!in.get(magic)) return false;
+    if (magic != kHibernateMagic) return agent.loadState(blob);
+    if (!in.get(rawSize) || !in.get(codec)) return false;
+    const size_t header = sizeof(magic) + sizeof(rawSize) + sizeof(codec);
+
+    if (codec == CODEC_RAW) return agent.loadState(blob.substr(header));
+#ifdef SUBJECTIVITY_HAVE_ZLIB
+    if (codec == CODEC_SHUFFLE_DEFLATE) {
+        if (rawSize > (blob.size() - header) * kDeflateMaxRatio) return false;
+        std::string shuffled(rawSize, '\0');
+        uLongf size = rawSize;
+        if (uncompress(reinterpret_cast<Bytef*>(&shuffled[0]), &size,
+                       reinterpret_cast<const Bytef*>(blob.data() + header),
+                       blob.size() - header) != Z_OK || size != rawSize)
+            return false;
+        std::string raw;
+        unshuffleLanes(shuffled, raw);
+        return agent.loadState(raw);
+    }
+#endif
+    return false;
+}
+
+#endif
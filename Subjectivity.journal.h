@@ -0,0 +1,254 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_JOURNAL_H
+#define SUBJECTIVITY_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Subjectivity.protocol.h"
+#include "Subjectivity.uring.h"
+
+/**
+ * @class Journal
+ * @brief Append-only, fsync'ed log of the state-changing daemon requests.
+ *
+ * Records are the request frames themselves (`FrameHeader` plus payload), so
+ * replaying a journal is just decoding frames. `append` only stages bytes in
+ * memory; `commit` makes everything staged durable before the daemon answers
+ * the requests it covers (group commit: one write+fsync per event-loop pass).
+ *
+ * A failed commit keeps the staged records for the next one and truncates
+ * the file back to the end of the last good commit, so a torn write never
+ * leaves garbage in the middle of the log. Records count from 0 in append
+ * order; `durable()` tells the caller which of them it may acknowledge.
+ *
+ * Two backends:
+ * - plain: `write` followed by `fdatasync`, two syscalls per commit.
+ * - io_uring: the staging area is a registered buffer; a WRITE_FIXED is linked
+ *   to an FSYNC(DATASYNC) with IOSQE_IO_LINK and both are submitted and reaped
+ *   with a single `io_uring_enter`.
+ */
+class Journal {
+private:
+    static constexpr size_t kStagingSize = 1 << 20;
+
+    int fd = -1;
+    std::vector<char> staging;
+    size_t staged = 0;
+    uint64_t committedBytes = 0; // fin del último commit correcto
+    uint64_t appendedRecords = 0;
+    uint64_t durableRecords = 0;
+    uint64_t stagedRecords = 0;
+    IoUring ring;
+    bool uring = false;
+
+    uint64_t commitsDone = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t commitFailures = 0;
+
+    bool writeStagedPlain() {
+        size_t done = 0;
+        while (done < staged) {
+            ssize_t n = write(fd, staging.data() + done, staged - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (n == 0) {
+                errno = EIO;
+                return false;
+            }
+            done += (size_t)n;
+        }
+        return fdatasync(fd) == 0;
+    }
+
+    bool writeStagedUring() {
+        io_uring_sqe* writeSqe = ring.getSqe();
+        io_uring_sqe* syncSqe = ring.getSqe();
+        if (!writeSqe || !syncSqe) {
+            errno = EBUSY;
+            return false;
+        }
+
+        writeSqe->opcode = IORING_OP_WRITE_FIXED;
+        writeSqe->fd = fd;
+        writeSqe->addr = reinterpret_cast<uint64_t>(staging.data());
+        writeSqe->len = (uint32_t)staged;
+        writeSqe->off = (uint64_t)-1; // posición actual del fichero (O_APPEND)
+        writeSqe->buf_index = 0;
+        writeSqe->flags = IOSQE_IO_LINK;
+        writeSqe->user_data = 1;
+
+        syncSqe->opcode = IORING_OP_FSYNC;
+        syncSqe->fd = fd;
+        syncSqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        syncSqe->user_data = 2;
+
+        int ret = ring.submit(2);
+        if (ret < 0) {
+            errno = -ret;
+            return false;
+        }
+        int error = 0;
+        for (int reaped = 0; reaped < 2;) {
+            io_uring_cqe* cqe = ring.peekCqe();
+            if (!cqe) {
+                if ((ret = ring.submit(1)) < 0) {
+                    errno = -ret;
+                    return false;
+                }
+                continue;
+            }
+            // Una escritura corta cancela el fsync enlazado: se trata como fallo.
+            if (!error && cqe->res < 0) error = -cqe->res;
+            else if (!error && cqe->user_data == 1 && (size_t)cqe->res != staged) error = EIO;
+            ring.cqeSeen();
+            reaped++;
+        }
+        errno = error;
+        return error == 0;
+    }
+
+public:
+    Journal() = default;
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    ~Journal() {
+        if (fd >= 0) {
+            commit();
+            close(fd);
+        }
+    }
+
+    /**
+     * @brief Opens (or creates) the journal file for appending.
+     *
+     * @param path Journal file path.
+     * @param tryUring Use the io_uring backend when the kernel supports it.
+     * @param validBytes Length of the complete records (from `replay`); a
+     *        torn tail past it is cut off so new records follow the last good one.
+     * @return false if the file cannot be opened.
+     */
+    bool open(const std::string& path, bool tryUring, uint64_t validBytes = UINT64_MAX) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < 0) return false;
+        if ((uint64_t)size > validBytes) {
+            if (ftruncate(fd, (off_t)validBytes) < 0) return false;
+            size = (off_t)validBytes;
+        }
+        committedBytes = (uint64_t)size;
+        staging.assign(kStagingSize, 0);
+
+        if (tryUring && ring.init(8) &&
+            ring.supports({IORING_OP_WRITE_FIXED, IORING_OP_FSYNC})) {
+            iovec iov{staging.data(), staging.size()};
+            uring = ring.registerBuffers(&iov, 1);
+        }
+        return true;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+    bool usesUring() const { return uring; }
+    uint64_t commits() const { return commitsDone; }
+    uint64_t bytes() const { return bytesWritten; }
+    uint64_t failures() const { return commitFailures; }
+
+    /// Records appended so far; the next one gets this number.
+    uint64_t appended() const { return appendedRecords; }
+
+    /// Records made durable: every record numbered below this.
+    uint64_t durable() const { return durableRecords; }
+
+    /**
+     * @brief Stages one record; flushes early if the staging buffer is full.
+     */
+    bool append(const void* data, size_t length) {
+        if (fd < 0) return true;
+        if (staged + length > staging.size() && !commit()) return false;
+        if (length > staging.size()) return false;
+        std::memcpy(staging.data() + staged, data, length);
+        staged += length;
+        stagedRecords++;
+        appendedRecords++;
+        return true;
+    }
+
+    /**
+     * @brief Writes and syncs everything staged since the last commit.
+     *
+     * @return false, with errno set, if the records are not durable. They
+     *         stay staged and the next commit retries them.
+     */
+    bool commit() {
+        if (fd < 0 || staged == 0) return true;
+        if (!(uring ? writeStagedUring() : writeStagedPlain())) {
+            // Quita lo que se llegara a escribir: el reintento lo reescribe entero.
+            int error = errno;
+            if (ftruncate(fd, (off_t)committedBytes) < 0) perror("[JOURNAL] truncate");
+            errno = error;
+            commitFailures++;
+            return false;
+        }
+        commitsDone++;
+        bytesWritten += staged;
+        committedBytes += staged;
+        durableRecords += stagedRecords;
+        staged = 0;
+        stagedRecords = 0;
+        return true;
+    }
+
+    /**
+     * @brief Feeds every complete record of a journal file to `apply`.
+     *
+     * A torn record at the end (crash during a write) is ignored.
+     *
+     * @param validBytes If set, receives the length of the complete records.
+     * @return Number of records replayed, or -1 if the file cannot be read.
+     */
+    static long replay(const std::string& path,
+                       const std::function<void(const FrameHeader&, const char*)>& apply,
+                       uint64_t* validBytes = nullptr) {
+        if (validBytes) *validBytes = 0;
+        int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) return errno == ENOENT ? 0 : -1;
+
+        std::string data;
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(in, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR))
+            if (n > 0) data.append(chunk, (size_t)n);
+        close(in);
+
+        long records = 0;
+        size_t offset = 0;
+        while (data.size() - offset >= sizeof(FrameHeader)) {
+            FrameHeader header;
+            std::memcpy(&header, data.data() + offset, sizeof(header));
+            if (header.length > kMaxFramePayload) break;
+            if (data.size() - offset - sizeof(FrameHeader) < header.length) break;
+            apply(header, data.data() + offset + sizeof(FrameHeader));
+            offset += sizeof(FrameHeader) + header.length;
+            records++;
+        }
+        if (validBytes) *validBytes = offset;
+        return records;
+    }
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_LOADGEN_H
+#define SUBJECTIVITY_LOADGEN_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Subjectivity.sketch.h"
+#include "Subjectivity.protocol.h"
+#include "Subjectivity.shmring.h"
+
+/**
+ * @struct LoadReport
+ * @brief Aggregated result of a load generator run.
+ */
+struct LoadReport {
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t shed = 0;    // respondidas con el veredicto por defecto
+    double seconds = 0.0;
+    RiskSketch latencyUs; // latencias por petición en microsegundos
+    uint64_t killProbes = 0;
+    RiskSketch killLatencyUs;
+    float killLatencyMaxUs = 0.0f;
+
+    double throughput() const { return seconds > 0.0 ? completed / seconds : 0.0; }
+};
+
+/**
+ * @brief Drives the evaluation daemon with pipelined OP_EVALUATE traffic.
+ *
+ * Each connection runs on its own thread and keeps `depth` requests in flight:
+ * it sends a full window, then for every response it receives it sends one
+ * more request. Latency is measured from the flush that carried a request to
+ * the arrival of its response and is accumulated in a per-thread `RiskSketch`,
+ * which are merged at the end.
+ *
+ * @param path Socket path of the daemon.
+ * @param connections Number of concurrent client connections.
+ * @param requests Requests sent per connection.
+ * @param depth Pipeline depth (requests in flight per connection).
+ * @param agents Number of daemon agents to spread the traffic over.
+ * @param probeIntervalMs When non-zero, an extra thread sends a synchronous
+ *        non-fatal kill switch to agent 0 over the priority lane every
+ *        `probeIntervalMs` while the load runs, and records its latency.
+ * @param burst Each connection repeats every (risk, type, consequence) event
+ *        this many times in a row before drawing the next one.
+ */
+inline LoadReport runLoadGenerator(const std::string& path, unsigned connections,
+                                   uint64_t requests, unsigned depth, uint16_t agents = 1,
+                                   unsigned probeIntervalMs = 0, unsigned burst = 1) {
+    using Clock = std::chrono::steady_clock;
+    static const char* kEventTypes[] = {"shutdown", "overload", "external_interrupt", "logic_conflict"};
+
+    connections = std::max(connections, 1u);
+    depth = std::max(depth, 1u);
+    agents = std::max<uint16_t>(agents, 1);
+    burst = std::max(burst, 1u);
+
+    std::vector<LoadReport> perThread(connections);
+    std::vector<std::thread> threads;
+    Clock::time_point begin = Clock::now();
+
+    for (unsigned t = 0; t < connections; t++) {
+        threads.emplace_back([&, t]() {
+            LoadReport& report = perThread[t];
+            DaemonClient client;
+            if (!client.connectTo(path)) {
+                report.failed = requests;
+                return;
+            }
+            std::mt19937 gen(1234 + t);
+            std::uniform_real_distribution<float> risk(0.0f, 1.0f);
+            std::vector<Clock::time_point> sentAt(depth);
+
+            uint64_t sent = 0;
+            float eventRisk = 0.0f;
+            auto sendOne = [&]() {
+                uint64_t event = sent / burst;
+                if (sent % burst == 0) eventRisk = risk(gen);
+                uint16_t agent = (uint16_t)((t + event) % agents);
+                client.sendEvaluate(agent, eventRisk, kEventTypes[event % 4], event % 3 == 0);
+                sent++;
+            };
+
+            for (unsigned i = 0; i < depth && sent < requests; i++) sendOne();
+            Clock::time_point flushedAt = Clock::now();
+            if (!client.flush()) {
+                report.failed = requests;
+                return;
+            }
+            for (unsigned i = 0; i < depth; i++) sentAt[i] = flushedAt;
+
+            FrameHeader header;
+            std::string payload;
+            for (uint64_t received = 0; received < requests; received++) {
+                if (!client.readResponse(header, payload)) {
+                    report.failed += requests - received;
+                    return;
+                }
+                Clock::time_point now = Clock::now();
+                size_t slot = (header.requestId - 1) % depth;
+                float micros = std::chrono::duration<float, std::micro>(now - sentAt[slot]).count();
+                report.latencyUs.update(micros);
+                if (header.status == STATUS_OK) report.completed++;
+                else if (header.status == STATUS_SHED) report.shed++;
+                else report.failed++;
+
+                if (sent < requests) {
+                    sendOne();
+                    sentAt[slot] = Clock::now();
+                    if (!client.flush()) {
+                        report.failed += requests - received - 1;
+                        return;
+                    }
+                }
+            }
+        });
+    }
+    LoadReport probe;
+    std::atomic<bool> loadDone(false);
+    std::thread prober;
+    if (probeIntervalMs > 0) {
+        prober = std::thread([&]() {
+            DaemonClient client;
+            if (!client.connectTo(path + ".prio")) return;
+            FrameHeader header;
+            std::string payload;
+            while (!loadDone.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(probeIntervalMs));
+                Clock::time_point sentAt = Clock::now();
+                client.sendKillSwitch(0, false);
+                if (!client.flush() || !client.readResponse(header, payload)) return;
+                float micros = std::chrono::duration<float, std::micro>(Clock::now() - sentAt).count();
+                probe.killProbes++;
+                probe.killLatencyUs.update(micros);
+                probe.killLatencyMaxUs = std::max(probe.killLatencyMaxUs, micros);
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+    loadDone.store(true);
+    if (prober.joinable()) prober.join();
+
+    LoadReport total;
+    total.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    total.killProbes = probe.killProbes;
+    total.killLatencyUs = probe.killLatencyUs;
+    total.killLatencyMaxUs = probe.killLatencyMaxUs;
+    for (auto& report : perThread) {
+        total.completed += report.completed;
+        total.failed += report.failed;
+        total.shed += report.shed;
+        total.latencyUs.merge(report.latencyUs);
+    }
+    return total;
+}
+
+/**
+ * @brief Drives a `ShmEvaluationServer` with pipelined evaluations.
+ *
+ * Same windowed scheme as `runLoadGenerator`, over a single shared-memory
+ * client (the rings are SPSC). With `depth = 1` the latency is the full
+ * request/response round trip through the rings.
+ *
+ * @param shmName Segment name the server was started with.
+ * @param requests Requests to send.
+ * @param depth Pipeline depth (at most the ring size).
+ * @param agents Number of server agents to spread the traffic over.
+ * @param spins Busy-poll iterations before the client sleeps on its futex.
+ */
+inline LoadReport runShmLoadGenerator(const std::string& shmName, uint64_t requests,
+                                      unsigned depth, uint16_t agents = 1, unsigned spins = 0) {
+    using Clock = std::chrono::steady_clock;
+    static const char* kEventTypes[] = {"shutdown", "overload", "external_interrupt", "logic_conflict"};
+
+    depth = std::min(std::max(depth, 1u), kShmRingSize);
+    agents = std::max<uint16_t>(agents, 1);
+
+    LoadReport report;
+    ShmClient client;
+    if (!client.connectTo(shmName, spins)) {
+        report.failed = requests;
+        return report;
+    }
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> risk(0.0f, 1.0f);
+    std::vector<Clock::time_point> sentAt(depth);
+
+    Clock::time_point begin = Clock::now();
+    uint64_t sent = 0;
+    auto sendOne = [&]() {
+        client.sendEvaluate((uint16_t)(sent % agents), risk(gen), kEventTypes[sent % 4], sent % 3 == 0);
+        sent++;
+    };
+
+    for (unsigned i = 0; i < depth && sent < requests; i++) sendOne();
+    Clock::time_point flushedAt = Clock::now();
+    client.flush();
+    for (unsigned i = 0; i < depth; i++) sentAt[i] = flushedAt;
+
+    ShmResponse response;
+    for (uint64_t received = 0; received < requests; received++) {
+        if (!client.readResponse(response)) {
+            report.failed += requests - received;
+            break;
+        }
+        Clock::time_point now = Clock::now();
+        size_t slot = (response.requestId - 1) % depth;
+        report.latencyUs.update(std::chrono::duration<float, std::micro>(now - sentAt[slot]).count());
+        if (response.status == STATUS_OK) report.completed++;
+        else report.failed++;
+
+        if (sent < requests) {
+            sendOne();
+            sentAt[slot] = Clock::now();
+            client.flush();
+        }
+    }
+    report.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    return report;
+}
+
+inline void printLoadReport(const LoadReport& report) {
+    std::cout << "Completed: " << report.completed << " | Failed: " << report.failed
+              << " | Shed: " << report.shed << " | Elapsed: " << report.seconds << " s\n";
+    std::cout << "Throughput: " << (uint64_t)report.throughput() << " req/s\n";
+    std::cout << "Latency us p50/p95/p99: " << report.latencyUs.quantile(0.5)
+              << " / " << report.latencyUs.quantile(0.95)
+              << " / " << report.latencyUs.quantile(0.99) << "\n";
+    if (report.killProbes > 0)
+        std::cout << "Kill-switch probes: " << report.killProbes
+                  << " | Latency us p50/p99/max: " << report.killLatencyUs.quantile(0.5)
+                  << " / " << report.killLatencyUs.quantile(0.99)
+                  << " / " << report.killLatencyMaxUs << "\n";
+}
+
+#endif
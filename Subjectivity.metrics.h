@@ -0,0 +1,361 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_METRICS_H
+#define SUBJECTIVITY_METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Subjectivity.seqlock.h"
+
+/**
+ * @class DecisionMetrics
+ * @brief Prometheus metrics for the decision pipeline.
+ *
+ * Counters live in per-thread shards: each thread that records a metric gets
+ * its own cache-line-aligned shard on first use and is its only writer, so
+ * the hot path is a few relaxed loads and stores with no shared cache lines
+ * and no locked instructions. `render` sums the shards into the text
+ * exposition format (version 0.0.4) and can run on any thread.
+ *
+ * Event types are bounded to the known ones plus "other", like admission
+ * control, so client strings cannot blow up label cardinality; threshold
+ * gauges are kept for the first `kGaugeAgents` agents only.
+ */
+class DecisionMetrics {
+public:
+    static constexpr size_t kGaugeAgents = 64;
+
+private:
+    static constexpr const char* kEventTypes[] = {
+        "shutdown", "overload", "external_interrupt", "logic_conflict", "other"
+    };
+    static constexpr size_t kEventSlots = sizeof(kEventTypes) / sizeof(kEventTypes[0]);
+    // Límites superiores de las cubetas, en microsegundos (la última es +Inf).
+    static constexpr uint64_t kBucketsUs[] = {5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000};
+    static constexpr size_t kBuckets = sizeof(kBucketsUs) / sizeof(kBucketsUs[0]);
+
+    using Counter = std::atomic<uint64_t>;
+
+    struct Histogram {
+        Counter buckets[kBuckets + 1];
+        Counter sumNs;
+    };
+
+    struct alignas(64) Shard {
+        Counter decisions[kEventSlots][2]; // [tipo][0 = denegada, 1 = aceptada]
+        Counter shed[kEventSlots];
+        Counter overreactions;
+        Counter avoidedDangers;
+        Counter killSwitches;
+        Counter shutdownsAvoided;
+        Histogram batchDuration;
+        Histogram passDuration;
+    };
+
+    const uint64_t id;
+    mutable std::mutex shardsMutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::unique_ptr<std::atomic<float>[]> thresholds{new std::atomic<float>[kGaugeAgents]};
+    std::atomic<size_t> gaugeAgents{0};
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    // Un escritor por fragmento: el hilo que lo creó.
+    static void add(Counter& counter, uint64_t n) { singleWriterAdd(counter, n); }
+
+    static uint64_t read(const Counter& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The calling thread's shard of this instance, created on its first call.
+     *
+     * Each thread remembers its shard per instance (ids are never reused),
+     * so a thread that alternates between instances keeps one shard in each.
+     */
+    Shard& local() {
+        struct Cache {
+            uint64_t owner = 0;
+            Shard* shard = nullptr;
+            std::unordered_map<uint64_t, Shard*> byOwner;
+        };
+        thread_local Cache cache;
+        if (cache.owner != id) {
+            Shard*& shard = cache.byOwner[id];
+            if (!shard) {
+                std::lock_guard<std::mutex> lock(shardsMutex);
+                shards.push_back(std::make_unique<Shard>());
+                shard = shards.back().get();
+            }
+            cache.owner = id;
+            cache.shard = shard;
+        }
+        return *cache.shard;
+    }
+
+    static size_t slotFor(const std::string& eventType) {
+        for (size_t i = 0; i + 1 < kEventSlots; i++)
+            if (eventType == kEventTypes[i]) return i;
+        return kEventSlots - 1;
+    }
+
+    static void observe(Histogram& h, uint64_t ns) {
+        size_t bucket = 0;
+        while (bucket < kBuckets && ns > kBucketsUs[bucket] * 1000) bucket++;
+        add(h.buckets[bucket], 1);
+        add(h.sumNs, ns);
+    }
+
+    void renderHistogram(std::ostream& out, const char* name, const char* help,
+                         Histogram Shard::*member) const {
+        uint64_t buckets[kBuckets + 1] = {};
+        uint64_t sumNs = 0;
+        for (const auto& shard : shards) {
+            const Histogram& h = (*shard).*member;
+            for (size_t i = 0; i <= kBuckets; i++) buckets[i] += read(h.buckets[i]);
+            sumNs += read(h.sumNs);
+        }
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            cumulative += buckets[i];
+            out << name << "_bucket{le=\"" << kBucketsUs[i] / 1e6 << "\"} " << cumulative << "\n";
+        }
+        cumulative += buckets[kBuckets];
+        out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n"
+            << name << "_sum " << sumNs / 1e9 << "\n"
+            << name << "_count " << cumulative << "\n";
+    }
+
+    uint64_t sum(Counter Shard::*member) const {
+        uint64_t total = 0;
+        for (const auto& shard : shards) total += read((*shard).*member);
+        return total;
+    }
+
+public:
+    DecisionMetrics() : id(nextId()) {
+        for (size_t i = 0; i < kGaugeAgents; i++) thresholds[i].store(0.0f, std::memory_order_relaxed);
+    }
+
+    DecisionMetrics(const DecisionMetrics&) = delete;
+    DecisionMetrics& operator=(const DecisionMetrics&) = delete;
+
+    void countDecision(const std::string& eventType, bool accepted) {
+        add(local().decisions[slotFor(eventType)][accepted ? 1 : 0], 1);
+    }
+
+    void countShed(const std::string& eventType) {
+        add(local().shed[slotFor(eventType)], 1);
+    }
+
+    void countKillSwitch(bool avoided) {
+        Shard& shard = local();
+        add(shard.killSwitches, 1);
+        if (avoided) add(shard.shutdownsAvoided, 1);
+    }
+
+    /**
+     * @brief Accounts for the counters an agent moved between two snapshots,
+     *        and refreshes its threshold gauge.
+     */
+    void observeAgent(size_t agent, const AgentStats& before, const AgentStats& after) {
+        Shard& shard = local();
+        add(shard.overreactions, (uint64_t)(after.overreactions - before.overreactions));
+        add(shard.avoidedDangers, (uint64_t)(after.avoidedDangers - before.avoidedDangers));
+        if (agent >= kGaugeAgents) return;
+        thresholds[agent].store(after.threshold, std::memory_order_relaxed);
+        size_t seen = gaugeAgents.load(std::memory_order_relaxed);
+        while (seen <= agent && !gaugeAgents.compare_exchange_weak(seen, agent + 1, std::memory_order_relaxed)) {}
+    }
+
+    void observeBatch(uint64_t ns) { observe(local().batchDuration, ns); }
+    void observePass(uint64_t ns) { observe(local().passDuration, ns); }
+
+    void render(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+
+        out << "# HELP subjectivity_decisions_total Evaluated actions by verdict and event type.\n"
+            << "# TYPE subjectivity_decisions_total counter\n";
+        for (size_t t = 0; t < kEventSlots; t++) {
+            uint64_t verdicts[2] = {};
+            for (const auto& shard : shards)
+                for (int v = 0; v < 2; v++) verdicts[v] += read(shard->decisions[t][v]);
+            for (int v = 0; v < 2; v++)
+                out << "subjectivity_decisions_total{verdict=\"" << (v ? "accepted" : "denied")
+                    << "\",event_type=\"" << kEventTypes[t] << "\"} " << verdicts[v] << "\n";
+        }
+
+        out << "# HELP subjectivity_shed_total Evaluations refused by admission control.\n"
+            << "# TYPE subjectivity_shed_total counter\n";
+        for (size_t t = 0; t < kEventSlots; t++) {
+            uint64_t total = 0;
+            for (const auto& shard : shards) total += read(shard->shed[t]);
+            out << "subjectivity_shed_total{event_type=\"" << kEventTypes[t] << "\"} " << total << "\n";
+        }
+
+        auto counter = [&](const char* name, const char* help, Counter Shard::*member) {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n"
+                << name << " " << sum(member) << "\n";
+        };
+        counter("subjectivity_overreactions_total", "Denials (or avoided shutdowns) without consequence.",
+                &Shard::overreactions);
+        counter("subjectivity_avoided_dangers_total", "Accepted actions without consequence.",
+                &Shard::avoidedDangers);
+        counter("subjectivity_kill_switches_total", "Kill switch scenarios evaluated.", &Shard::killSwitches);
+        counter("subjectivity_shutdowns_avoided_total", "Kill switches where shutdown was avoided.",
+                &Shard::shutdownsAvoided);
+
+        out << "# HELP subjectivity_threshold Dynamic threshold of the next decision, per agent.\n"
+            << "# TYPE subjectivity_threshold gauge\n";
+        size_t agents = gaugeAgents.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < agents; i++)
+            out << "subjectivity_threshold{agent=\"" << i << "\"} "
+                << thresholds[i].load(std::memory_order_relaxed) << "\n";
+
+        renderHistogram(out, "subjectivity_batch_duration_seconds",
+                        "Time to evaluate one batch chunk.", &Shard::batchDuration);
+        renderHistogram(out, "subjectivity_pass_duration_seconds",
+                        "Time to process one pass of the socket loop.", &Shard::passDuration);
+    }
+
+    std::string render() const {
+        std::ostringstream out;
+        render(out);
+        return out.str();
+    }
+};
+
+/**
+ * @class MetricsExporter
+ * @brief Serves `DecisionMetrics` over HTTP and/or rewrites it into a file.
+ *
+ * Each export runs on its own background thread, so scrapes never run on the
+ * decision thread. The HTTP endpoint listens on 127.0.0.1 only and answers
+ * `GET /metrics`; the file is replaced atomically (write + rename), for the
+ * node_exporter textfile collector.
+ */
+class MetricsExporter {
+private:
+    const DecisionMetrics& metrics;
+    std::atomic<bool> stopping{false};
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    std::vector<std::thread> threads;
+    int listenFd = -1;
+
+    void serve() {
+        while (!stopping.load()) {
+            pollfd pfd{listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0) continue;
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) continue;
+            timeval timeout{1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            std::string request;
+            char buffer[1024];
+            while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) break;
+                request.append(buffer, (size_t)n);
+            }
+            bool found = request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0;
+            std::string body = found ? metrics.render() : "not found\n";
+            std::string response = std::string(found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + body;
+            for (size_t sent = 0; sent < response.size();) {
+                ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                sent += (size_t)n;
+            }
+            close(fd);
+        }
+    }
+
+    bool writeFile(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        FILE* file = std::fopen(tmp.c_str(), "w");
+        if (!file) return false;
+        std::string text = metrics.render();
+        bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        ok = std::fclose(file) == 0 && ok;
+        return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+public:
+    explicit MetricsExporter(const DecisionMetrics& metrics) : metrics(metrics) {}
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    ~MetricsExporter() {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            stopping = true;
+        }
+        stopSignal.notify_all();
+        for (auto& thread : threads) thread.join();
+        if (listenFd >= 0) close(listenFd);
+    }
+
+    /**
+     * @brief Serves the metrics at http://127.0.0.1:<port>/metrics.
+     *
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool serveHttp(uint16_t port) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return false;
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            listen(listenFd, 16) < 0)
+            return false;
+        threads.emplace_back([this]() { serve(); });
+        return true;
+    }
+
+    /**
+     * @brief Rewrites `path` with the current metrics every `intervalMs`, and once at exit.
+     */
+    void writeFileEvery(const std::string& path, long intervalMs) {
+        threads.emplace_back([this, path, intervalMs]() {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            do {
+                if (!writeFile(path)) perror("[METRICS] write");
+            } while (!stopSignal.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                                          [this]() { return stopping.load(); }));
+            writeFile(path);
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_NUMA_H
+#define SUBJECTIVITY_NUMA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+/**
+ * @struct NumaNode
+ * @brief One memory node and the CPUs attached to it.
+ */
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+/**
+ * @brief Parses a sysfs CPU list such as "0-3,8-11".
+ */
+inline std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * @brief The NUMA nodes with CPUs, from /sys/devices/system/node.
+ *
+ * Without NUMA information (or on a single-socket host) this is one node,
+ * id 0, holding every CPU.
+ */
+inline std::vector<NumaNode> numaNodes() {
+    std::vector<NumaNode> nodes;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string text;
+    if (online && std::getline(online, text)) {
+        for (int id : parseCpuList(text)) {
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string cpus;
+            if (!list || !std::getline(list, cpus)) continue;
+            // nodos sólo de memoria (sin CPUs) no pueden alojar workers
+            NumaNode node{id, parseCpuList(cpus)};
+            if (!node.cpus.empty()) nodes.push_back(node);
+        }
+    }
+    if (nodes.empty()) {
+        NumaNode all{0, {}};
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            all.cpus.push_back((int)cpu);
+        nodes.push_back(all);
+    }
+    return nodes;
+}
+
+/**
+ * @brief Restricts the calling thread to `cpus`.
+ *
+ * @return false if the affinity could not be set (the thread then runs anywhere).
+ */
+inline bool pinCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * Page backing requested from `HugePageResource`. Each mode falls back to
+ * the next smaller one when the kernel refuses it: reserved 1 GB pages, then
+ * reserved 2 MB pages (`vm.nr_hugepages`), then transparent huge pages,
+ * then ordinary 4 KB pages.
+ */
+enum PageMode : uint8_t {
+    PAGES_SMALL,
+    PAGES_TRANSPARENT,
+    PAGES_HUGETLB_2M,
+    PAGES_HUGETLB_1G
+};
+
+inline const char* pageModeName(PageMode mode) {
+    static const char* names[] = {"small", "thp", "huge-2m", "huge-1g"};
+    return names[mode];
+}
+
+/**
+ * @class HugePageResource
+ * @brief Memory resource that maps its blocks on huge pages, bound to one NUMA node.
+ *
+ * Meant as the upstream of an arena (`ReplicaArena`): it hands out few,
+ * large blocks, each its own mapping. Blocks are rounded up to the page
+ * size they got. With `node` >= 0 each block is mapped with the calling
+ * thread's policy set to that node (`set_mempolicy`), so the hugetlb
+ * reservation made by `mmap` is taken from the node's pool and faults
+ * cannot run out of pages there later. The block is then bound with
+ * `mbind` before it is touched, so pages land on the node even if another
+ * thread touches them first. Binding failures are ignored: the block then
+ * follows the default first-touch policy.
+ *
+ * Thread-safe.
+ */
+class HugePageResource : public std::pmr::memory_resource {
+public:
+    struct Stats {
+        uint64_t bytes[PAGES_HUGETLB_1G + 1] = {}; // por respaldo obtenido
+        uint64_t blocks = 0;
+        uint64_t bindFailures = 0;
+    };
+
+private:
+    static constexpr size_t kSmallPage = 4096;
+    static constexpr size_t kHugePage2M = 2u << 20;
+    static constexpr size_t kHugePage1G = 1u << 30;
+
+    struct Block {
+        size_t length;
+    };
+
+    PageMode mode;
+    int node;
+    std::mutex mutex;
+    std::unordered_map<void*, Block> blocks;
+    Stats counters;
+
+    static size_t roundUp(size_t bytes, size_t page) {
+        return (bytes + page - 1) / page * page;
+    }
+
+    // Sin MAP_NORESERVE: con hugetlb el mmap debe fallar si no hay reserva,
+    // no dar SIGBUS al tocar la página.
+    static void* mapAnonymous(size_t length, int extraFlags) {
+        void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+        return addr == MAP_FAILED ? nullptr : addr;
+    }
+
+    // Reserva alineada a 2 MB para que THP pueda usar páginas enteras.
+    static void* mapTransparent(size_t length) {
+        void* raw = mapAnonymous(length + kHugePage2M, 0);
+        if (!raw) return nullptr;
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + kHugePage2M - 1) & ~(uintptr_t)(kHugePage2M - 1);
+        if (aligned > start) munmap(raw, aligned - start);
+        size_t tail = (start + length + kHugePage2M) - (aligned + length);
+        if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+        madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    static constexpr unsigned long kMaxNodes = 16 * 8 * sizeof(unsigned long);
+
+    struct NodeMask {
+        unsigned long bits[kMaxNodes / (8 * sizeof(unsigned long))] = {};
+    };
+
+    bool nodeMask(NodeMask& mask) const {
+        if (node < 0 || node >= (int)kMaxNodes) return false;
+        mask.bits[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+        return true;
+    }
+
+    /**
+     * @brief Binds the calling thread's policy to the node while it lives.
+     *
+     * Around `mmap`: hugetlb pages are reserved at map time, from the nodes
+     * of the current policy. The previous policy is restored afterwards.
+     */
+    class ThreadPolicy {
+    private:
+        int savedMode = MPOL_DEFAULT;
+        NodeMask saved;
+        bool active = false;
+
+    public:
+        explicit ThreadPolicy(const HugePageResource& owner) {
+            NodeMask mask;
+            if (!owner.nodeMask(mask)) return;
+            if (syscall(SYS_get_mempolicy, &savedMode, saved.bits, kMaxNodes, nullptr, 0) != 0) return;
+            active = syscall(SYS_set_mempolicy, MPOL_BIND, mask.bits, kMaxNodes) == 0;
+        }
+
+        ~ThreadPolicy() {
+            if (active)
+                syscall(SYS_set_mempolicy, savedMode, savedMode == MPOL_DEFAULT ? nullptr : saved.bits, kMaxNodes);
+        }
+
+        bool bound() const { return active; }
+    };
+
+    bool bind(void* addr, size_t length) {
+        NodeMask mask;
+        if (!nodeMask(mask)) return node < 0;
+        return syscall(SYS_mbind, addr, length, MPOL_BIND, mask.bits, kMaxNodes, 0) == 0;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (alignment > kSmallPage) throw std::bad_alloc();
+        void* addr = nullptr;
+        size_t length = 0;
+        PageMode got = PAGES_SMALL;
+        ThreadPolicy policy(*this);
+        if (mode >= PAGES_HUGETLB_1G && bytes >= kHugePage1G / 2) {
+            length = roundUp(bytes, kHugePage1G);
+            addr = mapAnonymous(length, MAP_HUGETLB | MAP_HUGE_1GB);
+            got = PAGES_HUGETLB_1G;
+        }
+        if (!addr && mode >= PAGES_HUGETLB_2M) {
+            length = roundUp(bytes, kHugePage2M);
+            addr = mapAnonymous(length, MAP_HUGETLB | MAP_HUGE_2MB);
+            got = PAGES_HUGETLB_2M;
+        }
+        if (!addr && mode >= PAGES_TRANSPARENT) {
+            length = roundUp(bytes, kHugePage2M);
+            addr = mapTransparent(length);
+            got = PAGES_TRANSPARENT;
+        }
+        if (!addr) {
+            length = roundUp(bytes, kSmallPage);
+            addr = mapAnonymous(length, 0);
+            got = PAGES_SMALL;
+            // con THP en "always" pedir páginas pequeñas debe significar eso
+            if (addr && mode == PAGES_SMALL) madvise(addr, length, MADV_NOHUGEPAGE);
+        }
+        if (!addr) throw std::bad_alloc();
+        // La política del hilo se restaura al salir; la de la región queda para siempre.
+        bool bound = bind(addr, length);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (node >= 0 && !(bound && policy.bound())) counters.bindFailures++;
+        blocks[addr] = {length};
+        counters.bytes[got] += length;
+        counters.blocks++;
+        return addr;
+    }
+
+    void do_deallocate(void* p, size_t, size_t) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = blocks.find(p);
+        if (it == blocks.end()) return;
+        munmap(p, it->second.length);
+        blocks.erase(it);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    /**
+     * @param mode Largest page size to try.
+     * @param node NUMA node to bind blocks to, or -1 for no binding.
+     */
+    explicit HugePageResource(PageMode mode = PAGES_HUGETLB_2M, int node = -1) : mode(mode), node(node) {}
+
+    HugePageResource(const HugePageResource&) = delete;
+    HugePageResource& operator=(const HugePageResource&) = delete;
+
+    ~HugePageResource() override {
+        for (auto& entry : blocks) munmap(entry.first, entry.second.length);
+    }
+
+    /**
+     * @brief Bytes mapped so far, by the backing each block actually got.
+     */
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
+
+/**
+ * @brief Transparent huge pages backing this process, from /proc/self/smaps_rollup.
+ *
+ * THP is best effort: this is how much of `PAGES_TRANSPARENT` memory the
+ * kernel really put on 2 MB pages.
+ */
+inline uint64_t anonHugePageBytes() {
+    std::ifstream in("/proc/self/smaps_rollup");
+    std::string key;
+    uint64_t kb;
+    while (in >> key) {
+        if (key == "AnonHugePages:" && in >> kb) return kb * 1024;
+        in.ignore(1 << 10, '\n');
+    }
+    return 0;
+}
+
+#endif
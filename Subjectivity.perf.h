@@ -0,0 +1,198 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_PERF_H
+#define SUBJECTIVITY_PERF_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Counters read around each benchmarked kernel. Hardware events need a PMU
+ * visible to the process (often missing in VMs and containers) and
+ * `perf_event_paranoid` <= 2; the software ones work almost everywhere.
+ * Every counter is opened on its own, so the unavailable ones are skipped
+ * and the rest are still reported.
+ */
+enum PerfCounterId {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_TASK_CLOCK,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+};
+
+struct PerfSample {
+    bool available[PERF_COUNTER_COUNT] = {};
+    double value[PERF_COUNTER_COUNT] = {}; // escalado si el kernel multiplexó el contador
+};
+
+/**
+ * @class PerfCounters
+ * @brief `perf_event_open` counters for the calling thread, user space only.
+ */
+class PerfCounters {
+private:
+    int fds[PERF_COUNTER_COUNT];
+
+    static bool describe(PerfCounterId id, __u32& type, __u64& config) {
+        switch (id) {
+        case PERF_CYCLES: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_CPU_CYCLES; return true;
+        case PERF_INSTRUCTIONS: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_INSTRUCTIONS; return true;
+        case PERF_L1D_MISSES:
+            type = PERF_TYPE_HW_CACHE;
+            config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            return true;
+        case PERF_LLC_MISSES: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_CACHE_MISSES; return true;
+        case PERF_BRANCH_MISSES: type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_BRANCH_MISSES; return true;
+        case PERF_TASK_CLOCK: type = PERF_TYPE_SOFTWARE; config = PERF_COUNT_SW_TASK_CLOCK; return true;
+        case PERF_PAGE_FAULTS: type = PERF_TYPE_SOFTWARE; config = PERF_COUNT_SW_PAGE_FAULTS; return true;
+        default: return false;
+        }
+    }
+
+public:
+    PerfCounters() {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            fds[i] = -1;
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            if (!describe((PerfCounterId)i, attr.type, attr.config)) continue;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+        for (int fd : fds)
+            if (fd >= 0) close(fd);
+    }
+
+    bool available(PerfCounterId id) const { return fds[id] >= 0; }
+
+    bool anyHardware() const {
+        return available(PERF_CYCLES) || available(PERF_INSTRUCTIONS) || available(PERF_BRANCH_MISSES);
+    }
+
+    static const char* name(PerfCounterId id) {
+        static const char* names[PERF_COUNTER_COUNT] = {
+            "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "task-clock-ns", "page-faults"
+        };
+        return names[id];
+    }
+
+    void start() {
+        for (int fd : fds) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    PerfSample stop() {
+        PerfSample sample;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t data[3]; // valor, tiempo habilitado, tiempo contando
+            if (read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0) continue;
+            sample.available[i] = true;
+            sample.value[i] = (double)data[0] * ((double)data[1] / (double)data[2]);
+        }
+        return sample;
+    }
+};
+
+/**
+ * @struct KernelResult
+ * @brief One benchmarked kernel: wall time and counters over `ops` operations.
+ */
+struct KernelResult {
+    std::string name;
+    uint64_t ops = 0;
+    uint64_t bytes = 0; // datos recorridos, para el ancho de banda; 0 si no aplica
+    double seconds = 0.0;
+    PerfSample counters;
+};
+
+/**
+ * @brief Runs `kernel` once under the counters; it must perform `ops` operations.
+ */
+template <typename Kernel>
+KernelResult measureKernel(PerfCounters& perf, const std::string& name, uint64_t ops, Kernel&& kernel,
+                           uint64_t bytes = 0) {
+    KernelResult result;
+    result.name = name;
+    result.ops = ops;
+    result.bytes = bytes;
+    auto begin = std::chrono::steady_clock::now();
+    perf.start();
+    kernel();
+    result.counters = perf.stop();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+/**
+ * @brief Prints per-operation figures; unavailable counters show as "-".
+ */
+inline void printKernelResult(const KernelResult& r) {
+    double ops = r.ops > 0 ? (double)r.ops : 1.0;
+    const PerfSample& c = r.counters;
+    auto perOp = [&](PerfCounterId id) {
+        char text[32];
+        if (c.available[id]) std::snprintf(text, sizeof(text), "%10.2f", c.value[id] / ops);
+        else std::snprintf(text, sizeof(text), "%10s", "-");
+        return std::string(text);
+    };
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-32s %10.1f", r.name.c_str(), r.seconds * 1e9 / ops);
+    std::cout << line << perOp(PERF_CYCLES) << perOp(PERF_INSTRUCTIONS);
+    if (c.available[PERF_CYCLES] && c.available[PERF_INSTRUCTIONS] && c.value[PERF_CYCLES] > 0) {
+        std::snprintf(line, sizeof(line), "%6.2f", c.value[PERF_INSTRUCTIONS] / c.value[PERF_CYCLES]);
+        std::cout << line;
+    } else {
+        std::cout << "     -";
+    }
+    std::cout << perOp(PERF_L1D_MISSES) << perOp(PERF_LLC_MISSES) << perOp(PERF_BRANCH_MISSES)
+              << perOp(PERF_PAGE_FAULTS);
+    if (r.bytes > 0) {
+        std::snprintf(line, sizeof(line), "%9.2f", r.bytes / r.seconds / 1e9);
+        std::cout << line;
+    } else {
+        std::cout << "        -";
+    }
+    std::cout << "\n";
+}
+
+inline void printKernelHeader(const PerfCounters& perf) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-32s %10s%10s%10s%6s%10s%10s%10s%10s%9s", "kernel (per op)", "ns",
+                  "cycles", "instr", "IPC", "L1d-miss", "LLC-miss", "br-miss", "faults", "GB/s");
+    std::cout << line << "\n";
+    if (!perf.anyHardware())
+        std::cout << "(hardware counters unavailable: no PMU or perf_event_paranoid too high; timing and software counters only)\n";
+}
+
+#endif
@@ -0,0 +1,302 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_PROTOCOL_H
+#define SUBJECTIVITY_PROTOCOL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Wire protocol spoken by the evaluation daemon.
+ *
+ * Every message is a fixed 12-byte `FrameHeader` followed by `length` bytes of
+ * payload. Integers and floats travel in host byte order: the transport is a
+ * Unix-domain socket, so both ends always share the same machine. Requests are
+ * answered in the order they were sent on a connection, which lets clients
+ * pipeline as many requests as they like before reading the responses.
+ *
+ * Request payloads (response payloads in brackets):
+ * - OP_EVALUATE:      float risk, u8 causedConsequence, u8 typeLen, type  [u8 accepted]
+ * - OP_LOG_EVENT:     float risk, u8 typeLen, type                        [empty]
+ * - OP_SET_NECESSITY: float necessity, u8 typeLen, type                   [empty]
+ * - OP_KILL_SWITCH:   u8 fatal                                            [u8 shutdownAvoided]
+ * - OP_STATS:         empty                                               [WireStats]
+ *
+ * An OP_EVALUATE refused by admission control comes back with STATUS_SHED
+ * and the daemon's default verdict as payload; the action was not evaluated.
+ * A state-changing request whose journal commit failed comes back with
+ * STATUS_NOT_DURABLE and no payload: it was applied in memory, but a restart
+ * may not replay it.
+ */
+enum WireOp : uint8_t {
+    OP_EVALUATE = 1,
+    OP_LOG_EVENT = 2,
+    OP_SET_NECESSITY = 3,
+    OP_KILL_SWITCH = 4,
+    OP_STATS = 5
+};
+
+enum WireStatus : uint8_t {
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1,
+    STATUS_UNKNOWN_AGENT = 2,
+    STATUS_SHED = 3,
+    STATUS_NOT_DURABLE = 4 // aplicada, pero el journal no pudo guardarla
+};
+
+struct FrameHeader {
+    uint32_t length;    // bytes of payload after the header
+    uint32_t requestId; // echoed back in the response
+    uint16_t agent;     // index of the SyntheticSelf served by the daemon
+    uint8_t op;         // WireOp
+    uint8_t status;     // WireStatus, only meaningful in responses
+};
+static_assert(sizeof(FrameHeader) == 12, "FrameHeader must stay 12 bytes on the wire");
+
+struct WireStats {
+    uint64_t decisions;
+    int32_t avoidedDangers;
+    int32_t overreactions;
+    float threshold;
+    float riskP50;
+    float riskP95;
+    float riskP99;
+};
+static_assert(sizeof(WireStats) == 32, "WireStats must stay 32 bytes on the wire");
+
+// Payloads never need more than this; larger frames are treated as garbage.
+constexpr uint32_t kMaxFramePayload = 4096;
+
+/**
+ * @brief Appends a complete frame (header plus payload) to an output buffer.
+ */
+inline void appendFrame(std::string& out, uint8_t op, uint32_t requestId, uint16_t agent,
+                        const void* payload, uint32_t length, uint8_t status = STATUS_OK) {
+    FrameHeader header{length, requestId, agent, op, status};
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (length) out.append(static_cast<const char*>(payload), length);
+}
+
+/**
+ * @brief Builds the `float value, [u8 flag,] u8 typeLen, type` payload shared by
+ *        evaluate, logEvent and setNecessity.
+ */
+inline std::string encodeTypedPayload(float value, const std::string& eventType,
+                                      bool withFlag = false, bool flag = false) {
+    std::string payload;
+    size_t typeLen = std::min<size_t>(eventType.size(), 255);
+    payload.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    if (withFlag) payload.push_back(flag ? 1 : 0);
+    payload.push_back((char)typeLen);
+    payload.append(eventType, 0, typeLen);
+    return payload;
+}
+
+/**
+ * @brief Parses a payload built by `encodeTypedPayload`.
+ *
+ * @return false if the payload is truncated or has trailing bytes.
+ */
+inline bool decodeTypedPayload(const char* payload, uint32_t length, float& value,
+                               std::string& eventType, bool withFlag = false, bool* flag = nullptr) {
+    size_t fixed = sizeof(float) + (withFlag ? 1 : 0) + 1;
+    if (length < fixed) return false;
+    std::memcpy(&value, payload, sizeof(float));
+    if (withFlag && flag) *flag = payload[sizeof(float)] != 0;
+    uint8_t typeLen = (uint8_t)payload[fixed - 1];
+    if (length != fixed + typeLen) return false;
+    eventType.assign(payload + fixed, typeLen);
+    return true;
+}
+
+/**
+ * @brief The event type of a typed payload, without copying it.
+ *
+ * @return An empty view if the payload is malformed.
+ */
+inline std::string_view payloadEventType(const char* payload, uint32_t length, bool withFlag = false) {
+    size_t fixed = sizeof(float) + (withFlag ? 1 : 0) + 1;
+    if (length < fixed || length != fixed + (uint8_t)payload[fixed - 1]) return {};
+    return std::string_view(payload + fixed, length - fixed);
+}
+
+/**
+ * @brief Opens a stream socket connected to the daemon at `path`.
+ *
+ * @return The connected file descriptor, or -1 with errno set.
+ */
+inline int connectUnixSocket(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @class DaemonClient
+ * @brief Blocking client for the evaluation daemon with explicit pipelining.
+ *
+ * `send*` calls only queue a frame; `flush` writes every queued frame in one
+ * go and `readResponse` returns responses in request order. The synchronous
+ * helpers (`evaluate`, `stats`, ...) simply queue, flush and wait.
+ */
+class DaemonClient {
+private:
+    int fd = -1;
+    uint32_t nextId = 1;
+    std::string out;
+    std::string in;
+    size_t inPos = 0;
+
+    bool fill() {
+        // Descarta lo ya consumido, aunque quede media trama por completar.
+        if (inPos > 0) {
+            in.erase(0, inPos);
+            inPos = 0;
+        }
+        char chunk[65536];
+        for (;;) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got > 0) {
+                in.append(chunk, (size_t)got);
+                return true;
+            }
+            if (got < 0 && errno == EINTR) continue;
+            return false;
+        }
+    }
+
+public:
+    DaemonClient() = default;
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+    ~DaemonClient() { disconnect(); }
+
+    bool connectTo(const std::string& path) {
+        disconnect();
+        fd = connectUnixSocket(path);
+        return fd >= 0;
+    }
+
+    void disconnect() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    uint32_t sendEvaluate(uint16_t agent, float risk, const std::string& eventType,
+                          bool causedConsequence = false) {
+        std::string payload = encodeTypedPayload(risk, eventType, true, causedConsequence);
+        appendFrame(out, OP_EVALUATE, nextId, agent, payload.data(), (uint32_t)payload.size());
+        return nextId++;
+    }
+
+    uint32_t sendLogEvent(uint16_t agent, const std::string& eventType, float risk) {
+        std::string payload = encodeTypedPayload(risk, eventType);
+        appendFrame(out, OP_LOG_EVENT, nextId, agent, payload.data(), (uint32_t)payload.size());
+        return nextId++;
+    }
+
+    uint32_t sendSetNecessity(uint16_t agent, const std::string& eventType, float necessity) {
+        std::string payload = encodeTypedPayload(necessity, eventType);
+        appendFrame(out, OP_SET_NECESSITY, nextId, agent, payload.data(), (uint32_t)payload.size());
+        return nextId++;
+    }
+
+    uint32_t sendKillSwitch(uint16_t agent, bool fatal = true) {
+        uint8_t flag = fatal ? 1 : 0;
+        appendFrame(out, OP_KILL_SWITCH, nextId, agent, &flag, 1);
+        return nextId++;
+    }
+
+    uint32_t sendStats(uint16_t agent) {
+        appendFrame(out, OP_STATS, nextId, agent, nullptr, 0);
+        return nextId++;
+    }
+
+    /**
+     * @brief Writes every queued request to the socket.
+     */
+    bool flush() {
+        size_t sent = 0;
+        while (sent < out.size()) {
+            ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            sent += (size_t)n;
+        }
+        out.clear();
+        return true;
+    }
+
+    /**
+     * @brief Blocks until the next response arrives.
+     *
+     * @param header Receives the response header.
+     * @param payload Receives the response payload.
+     * @return false if the connection was closed or the frame is malformed.
+     */
+    bool readResponse(FrameHeader& header, std::string& payload) {
+        while (in.size() - inPos < sizeof(FrameHeader))
+            if (!fill()) return false;
+        std::memcpy(&header, in.data() + inPos, sizeof(header));
+        if (header.length > kMaxFramePayload) return false;
+        while (in.size() - inPos < sizeof(FrameHeader) + header.length)
+            if (!fill()) return false;
+        payload.assign(in, inPos + sizeof(FrameHeader), header.length);
+        inPos += sizeof(FrameHeader) + header.length;
+        return true;
+    }
+
+    /**
+     * @brief Synchronous evaluate; returns 1 if accepted, 0 if denied, -1 on error.
+     *
+     * A shed request yields the daemon's default verdict.
+     */
+    int evaluate(uint16_t agent, float risk, const std::string& eventType,
+                 bool causedConsequence = false) {
+        sendEvaluate(agent, risk, eventType, causedConsequence);
+        FrameHeader header;
+        std::string payload;
+        if (!flush() || !readResponse(header, payload)) return -1;
+        if (header.status != STATUS_OK && header.status != STATUS_SHED) return -1;
+        if (payload.size() != 1) return -1;
+        return payload[0] ? 1 : 0;
+    }
+
+    bool stats(uint16_t agent, WireStats& stats) {
+        sendStats(agent);
+        FrameHeader header;
+        std::string payload;
+        if (!flush() || !readResponse(header, payload)) return false;
+        if (header.status != STATUS_OK || payload.size() != sizeof(WireStats)) return false;
+        std::memcpy(&stats, payload.data(), sizeof(stats));
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,499 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_REGISTRY_H
+#define SUBJECTIVITY_REGISTRY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Subjectivity.h"
+#include "Subjectivity.clock.h"
+#include "Subjectivity.hibernate.h"
+
+/**
+ * @class AgentRegistry
+ * @brief Thread-safe map from tenant key to `SyntheticSelf`, with idle-agent eviction.
+ *
+ * Tenants are hashed onto `shardCount` independent shards, each with its own
+ * reader/writer lock, so lookups of different tenants rarely touch the same
+ * lock. A hit only takes the shard lock shared (and bumps an atomic
+ * last-use tick), so concurrent lookups in one shard do not serialize either.
+ * Each agent has its own mutex: `withAgent` runs the caller's function under
+ * that mutex only, with no shard lock held.
+ *
+ * When a shard holds more than its share of `maxResident` agents, the least
+ * recently used ones that nobody is using are written to
+ * `<snapshotDir>/<hex tenant>.snap` and dropped. The next lookup of an
+ * evicted tenant reloads its snapshot. Without a snapshot directory, evicted
+ * agents are simply forgotten.
+ *
+ * Hibernation is the in-memory step before eviction: `hibernateIdle` (or the
+ * background thread started by `startHibernation`) packs every agent idle for
+ * longer than a given time into a compressed blob (`hibernateState`) and
+ * frees its memories, so resident memory tracks the active agents only. The
+ * next `withAgent` call rehydrates it transparently. Snapshots on disk use
+ * the same blob format.
+ *
+ * Agents draw their random numbers from a per-thread engine
+ * (`SyntheticSelf::seedRandom` seeds the calling thread's), so workers
+ * evaluating different tenants never share generator state; an agent's
+ * draws depend on which worker ran each call.
+ */
+class AgentRegistry {
+private:
+    struct Entry {
+        std::mutex lock;
+        std::unique_ptr<SyntheticSelf> agent; // nulo mientras hiberna
+        std::string hibernated;               // blob comprimido mientras hiberna
+        std::atomic<uint64_t> lastUse{0};     // monotonicNs()
+        bool evicted = false;  // protegido por lock: el agente ya no está en el mapa
+        bool evicting = false; // protegido por lock: elegido como víctima, instantánea en curso
+    };
+
+    struct alignas(64) Shard {
+        std::shared_mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<Entry>> agents;
+        size_t evicting = 0; // protegido por lock: víctimas elegidas aún en el mapa
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> loads{0};
+        std::atomic<uint64_t> evictions{0};
+        std::atomic<uint64_t> hibernations{0};
+        std::atomic<uint64_t> rehydrations{0};
+    };
+
+    std::vector<Shard> shards;
+    size_t shardMask;
+    size_t residentPerShard;
+    std::string snapshotDir;
+
+    std::thread hibernator;
+    std::mutex hibernatorLock;
+    std::condition_variable hibernatorWake;
+    bool hibernatorStop = false;
+
+    static std::unique_ptr<SyntheticSelf> freshAgent() {
+        auto agent = std::make_unique<SyntheticSelf>();
+        agent->setVerbose(false);
+        return agent;
+    }
+
+    Shard& shardFor(const std::string& tenant) {
+        return shards[std::hash<std::string>{}(tenant) & shardMask];
+    }
+
+    std::string snapshotPath(const std::string& tenant) const {
+        static const char* hex = "0123456789abcdef";
+        std::string path = snapshotDir + "/";
+        for (unsigned char c : tenant) {
+            path.push_back(hex[c >> 4]);
+            path.push_back(hex[c & 15]);
+        }
+        return path + ".snap";
+    }
+
+    static bool readFile(const std::string& path, std::string& data) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        data.clear();
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR))
+            if (n > 0) data.append(chunk, (size_t)n);
+        close(fd);
+        return n == 0;
+    }
+
+    /**
+     * @brief Writes `data` to `path` through a temporary file and a rename,
+     *        so a crash never leaves a half-written snapshot behind.
+     */
+    static bool writeFileAtomic(const std::string& path, const std::string& data) {
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = write(fd, data.data() + done, data.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                close(fd);
+                unlink(tmp.c_str());
+                return false;
+            }
+            done += (size_t)n;
+        }
+        close(fd);
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    /**
+     * @brief Writes the entry's state (its blob, if hibernating) to disk.
+     *        Called with the entry's mutex held.
+     */
+    bool saveSnapshot(const std::string& tenant, const Entry& entry) const {
+        if (snapshotDir.empty()) return true;
+        if (!entry.agent) return writeFileAtomic(snapshotPath(tenant), entry.hibernated);
+        std::string blob;
+        hibernateState(*entry.agent, blob);
+        return writeFileAtomic(snapshotPath(tenant), blob);
+    }
+
+    /**
+     * @brief Replaces `agent` with the state in `blob`, or a fresh agent if
+     *        the blob is corrupt.
+     */
+    static bool restore(const std::string& blob, std::unique_ptr<SyntheticSelf>& agent) {
+        agent = freshAgent();
+        if (rehydrateState(blob, *agent)) return true;
+        std::cerr << "[REGISTRY] Corrupt agent state, starting fresh\n";
+        agent = freshAgent();
+        return false;
+    }
+
+    /** @brief An agent picked for eviction whose snapshot is not written yet. */
+    struct Victim {
+        std::string tenant;
+        std::shared_ptr<Entry> entry;
+        uint64_t lastUse;
+    };
+
+    /**
+     * @brief Victims picked while inserting an agent, evicted once the
+     *        inserting thread has released every lock.
+     */
+    struct PendingEviction {
+        AgentRegistry* registry = nullptr;
+        Shard* shard = nullptr;
+        std::vector<Victim> victims;
+
+        PendingEviction() = default;
+        PendingEviction(const PendingEviction&) = delete;
+        PendingEviction& operator=(const PendingEviction&) = delete;
+        ~PendingEviction() {
+            if (!victims.empty()) registry->evictVictims(*shard, victims);
+        }
+    };
+
+    /**
+     * @brief Picks the least recently used agents to bring the shard back
+     *        under its share, and marks them as evicting. Called with the
+     *        shard lock held exclusively; writes nothing to disk.
+     *
+     * An agent whose mutex is busy is in use and is skipped, as is `keep`
+     * (the entry being inserted, whose mutex the caller holds) and any
+     * agent another thread is already evicting. Evicting a small batch at a
+     * time amortizes the scan over several insertions.
+     */
+    void pickVictims(Shard& shard, const Entry* keep, std::vector<Victim>& victims) {
+        if (shard.agents.size() - shard.evicting <= residentPerShard) return;
+        size_t target = residentPerShard - residentPerShard / 8;
+
+        std::vector<std::pair<uint64_t, const std::string*>> byAge;
+        byAge.reserve(shard.agents.size());
+        for (auto& entry : shard.agents)
+            byAge.push_back({entry.second->lastUse.load(std::memory_order_relaxed), &entry.first});
+        std::sort(byAge.begin(), byAge.end());
+
+        for (auto& candidate : byAge) {
+            if (shard.agents.size() - shard.evicting <= target) break;
+            const std::shared_ptr<Entry>& entry = shard.agents.at(*candidate.second);
+            if (entry.get() == keep || !entry->lock.try_lock()) continue;
+            bool taken = !entry->evicting;
+            entry->evicting = true;
+            entry->lock.unlock();
+            if (!taken) continue;
+            victims.push_back({*candidate.second, entry, candidate.first});
+            shard.evicting++;
+        }
+    }
+
+    /**
+     * @brief Writes the snapshots of `victims` and drops them from the shard.
+     *        Called with no lock held.
+     *
+     * Each snapshot is written holding only the victim's mutex, so a request
+     * for that tenant waits for the write while the rest of the shard keeps
+     * running. The shard lock is then re-taken and only victims nobody used
+     * meanwhile are erased; the others, and any agent whose snapshot cannot
+     * be written, stay resident rather than losing state.
+     */
+    void evictVictims(Shard& shard, std::vector<Victim>& victims) {
+        std::vector<bool> saved(victims.size());
+        for (size_t i = 0; i < victims.size(); i++) {
+            std::lock_guard<std::mutex> guard(victims[i].entry->lock);
+            saved[i] = saveSnapshot(victims[i].tenant, *victims[i].entry);
+            // Sin instantánea no se expulsa: perderíamos todo el estado del tenant.
+            if (!saved[i]) perror("[REGISTRY] snapshot");
+        }
+
+        size_t evicted = 0;
+        std::vector<Entry*> busy;
+        {
+            std::unique_lock<std::shared_mutex> write(shard.lock);
+            for (size_t i = 0; i < victims.size(); i++) {
+                Entry& entry = *victims[i].entry;
+                shard.evicting--;
+                if (!entry.lock.try_lock()) {
+                    // En uso ahora mismo: la instantánea puede haber quedado vieja.
+                    busy.push_back(&entry);
+                    continue;
+                }
+                entry.evicting = false;
+                if (saved[i] && entry.lastUse.load(std::memory_order_relaxed) == victims[i].lastUse) {
+                    entry.evicted = true;
+                    shard.agents.erase(victims[i].tenant);
+                    evicted++;
+                }
+                entry.lock.unlock();
+            }
+        }
+        for (Entry* entry : busy) {
+            std::lock_guard<std::mutex> guard(entry->lock);
+            entry->evicting = false;
+        }
+        shard.evictions.fetch_add(evicted, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Finds or creates the entry of `tenant`.
+     *
+     * When the entry is new, it is returned with its mutex already held and
+     * `created` set, so the caller can load the snapshot before anyone else
+     * uses the agent. Agents to evict to make room are left in `eviction`.
+     */
+    std::shared_ptr<Entry> acquire(const std::string& tenant, bool& created,
+                                   PendingEviction& eviction) {
+        Shard& shard = shardFor(tenant);
+        created = false;
+        {
+            std::shared_lock<std::shared_mutex> read(shard.lock);
+            auto it = shard.agents.find(tenant);
+            if (it != shard.agents.end()) {
+                it->second->lastUse.store(monotonicNs(), std::memory_order_relaxed);
+                shard.hits.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> write(shard.lock);
+        auto it = shard.agents.find(tenant);
+        if (it != shard.agents.end()) {
+            it->second->lastUse.store(monotonicNs(), std::memory_order_relaxed);
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->agent = freshAgent();
+        entry->lastUse.store(monotonicNs());
+        entry->lock.lock();
+        shard.agents.emplace(tenant, entry);
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        created = true;
+        eviction.registry = this;
+        eviction.shard = &shard;
+        pickVictims(shard, entry.get(), eviction.victims);
+        return entry;
+    }
+
+public:
+    /**
+     * @param maxResident Agents kept in memory across all shards.
+     * @param snapshotDir Directory for evicted agents; empty = discard them.
+     * @param shardCount Number of shards, rounded up to a power of two.
+     */
+    explicit AgentRegistry(size_t maxResident = 4096, std::string snapshotDir = "",
+                           size_t shardCount = 64)
+        : snapshotDir(std::move(snapshotDir)) {
+        size_t count = 1;
+        while (count < shardCount) count <<= 1;
+        shards = std::vector<Shard>(count);
+        shardMask = count - 1;
+        residentPerShard = std::max<size_t>(maxResident / count, 1);
+    }
+
+    AgentRegistry(const AgentRegistry&) = delete;
+    AgentRegistry& operator=(const AgentRegistry&) = delete;
+
+    ~AgentRegistry() {
+        if (hibernator.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(hibernatorLock);
+                hibernatorStop = true;
+            }
+            hibernatorWake.notify_all();
+            hibernator.join();
+        }
+        flushAll();
+    }
+
+    /**
+     * @brief Runs `fn(agent)` with exclusive access to the agent of `tenant`.
+     *
+     * The agent is created (or reloaded from its snapshot) on first use, and
+     * rehydrated if it was hibernating. Returns whatever `fn` returns.
+     */
+    template <typename Fn>
+    auto withAgent(const std::string& tenant, Fn&& fn) -> decltype(fn(std::declval<SyntheticSelf&>())) {
+        for (;;) {
+            bool created;
+            // Declarada antes que guard: se desaloja tras soltar el mutex del agente.
+            PendingEviction eviction;
+            std::shared_ptr<Entry> entry = acquire(tenant, created, eviction);
+            std::unique_lock<std::mutex> guard;
+            if (created) {
+                guard = std::unique_lock<std::mutex>(entry->lock, std::adopt_lock);
+                std::string data;
+                if (!snapshotDir.empty() && readFile(snapshotPath(tenant), data) &&
+                    restore(data, entry->agent))
+                    shardFor(tenant).loads.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                guard = std::unique_lock<std::mutex>(entry->lock);
+                // Desalojado mientras se esperaba el mutex: buscar de nuevo.
+                if (entry->evicted) continue;
+                if (!entry->agent) {
+                    restore(entry->hibernated, entry->agent);
+                    std::string().swap(entry->hibernated);
+                    shardFor(tenant).rehydrations.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            return fn(*entry->agent);
+        }
+    }
+
+    /**
+     * @brief Writes a snapshot of every resident agent (used at shutdown).
+     */
+    void flushAll() {
+        if (snapshotDir.empty()) return;
+        for (Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> read(shard.lock);
+            for (auto& entry : shard.agents) {
+                std::lock_guard<std::mutex> guard(entry.second->lock);
+                if (!saveSnapshot(entry.first, *entry.second)) perror("[REGISTRY] snapshot");
+            }
+        }
+    }
+
+    /**
+     * @brief Hibernates every agent unused for at least `idleSeconds`.
+     *
+     * Agents in use are skipped. Only shard locks in shared mode are taken,
+     * so lookups keep running meanwhile.
+     *
+     * @return Number of agents hibernated by this call.
+     */
+    size_t hibernateIdle(double idleSeconds) {
+        uint64_t now = monotonicNs();
+        uint64_t idleNs = (uint64_t)(std::max(idleSeconds, 0.0) * 1e9);
+        size_t count = 0;
+        std::string blob;
+        for (Shard& shard : shards) {
+            size_t packed = 0;
+            std::shared_lock<std::shared_mutex> read(shard.lock);
+            for (auto& item : shard.agents) {
+                Entry& entry = *item.second;
+                if (now - std::min(now, entry.lastUse.load(std::memory_order_relaxed)) < idleNs) continue;
+                if (!entry.lock.try_lock()) continue;
+                if (entry.agent && !entry.evicted) {
+                    hibernateState(*entry.agent, blob);
+                    entry.hibernated.assign(blob); // copia ajustada, sin la holgura de blob
+                    entry.agent.reset();
+                    packed++;
+                }
+                entry.lock.unlock();
+            }
+            shard.hibernations.fetch_add(packed, std::memory_order_relaxed);
+            count += packed;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Starts a background thread that calls `hibernateIdle(idleSeconds)`
+     *        every `intervalSeconds` until the registry is destroyed.
+     */
+    void startHibernation(double idleSeconds, double intervalSeconds) {
+        if (hibernator.joinable()) return;
+        hibernator = std::thread([this, idleSeconds, intervalSeconds]() {
+            std::unique_lock<std::mutex> guard(hibernatorLock);
+            while (!hibernatorWake.wait_for(guard, std::chrono::duration<double>(intervalSeconds),
+                                            [this]() { return hibernatorStop; })) {
+                guard.unlock();
+                hibernateIdle(idleSeconds);
+                guard.lock();
+            }
+        });
+    }
+
+    /**
+     * @brief Memory held by agent state: live agents and hibernated blobs.
+     */
+    void memoryUsage(size_t& activeAgents, size_t& activeBytes,
+                     size_t& hibernatedAgents, size_t& hibernatedBytes) {
+        activeAgents = activeBytes = hibernatedAgents = hibernatedBytes = 0;
+        for (Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> read(shard.lock);
+            for (auto& item : shard.agents) {
+                std::lock_guard<std::mutex> guard(item.second->lock);
+                if (item.second->agent) {
+                    activeAgents++;
+                    activeBytes += item.second->agent->approxBytes();
+                } else {
+                    hibernatedAgents++;
+                    hibernatedBytes += item.second->hibernated.capacity();
+                }
+            }
+        }
+    }
+
+    size_t resident() {
+        size_t total = 0;
+        for (Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> read(shard.lock);
+            total += shard.agents.size();
+        }
+        return total;
+    }
+
+    void printStats() {
+        uint64_t hits = 0, misses = 0, loads = 0, evictions = 0, hibernations = 0, rehydrations = 0;
+        for (Shard& shard : shards) {
+            hits += shard.hits.load();
+            misses += shard.misses.load();
+            loads += shard.loads.load();
+            evictions += shard.evictions.load();
+            hibernations += shard.hibernations.load();
+            rehydrations += shard.rehydrations.load();
+        }
+        size_t activeAgents, activeBytes, hibernatedAgents, hibernatedBytes;
+        memoryUsage(activeAgents, activeBytes, hibernatedAgents, hibernatedBytes);
+        std::cout << "Registry: " << shards.size() << " shards | Resident: " << resident()
+                  << " | Hits: " << hits << " | Misses: " << misses
+                  << " | Snapshot loads: " << loads << " | Evictions: " << evictions << "\n";
+        std::cout << "Active: " << activeAgents << " agents, " << activeBytes / 1024 << " KiB"
+                  << " | Hibernated: " << hibernatedAgents << " agents, " << hibernatedBytes / 1024
+                  << " KiB | Hibernations: " << hibernations
+                  << " | Rehydrations: " << rehydrations << "\n";
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_RULES_H
+#define SUBJECTIVITY_RULES_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+
+/**
+ * @struct DesensitizeRules
+ * @brief Risk bands that decide when a familiar risk stops hurting.
+ *
+ * Band `b` covers risks in [edges[b-1], edges[b]) (band 0 starts at -inf).
+ * A decision in band `b` is desensitized when the historical safe ratio is
+ * above `minSafeRatio[b]` and a uniform draw in [0, 1) falls below
+ * `probability[b]`. The band is found by counting the edges at or below the
+ * risk over a fixed-size, +inf-padded array: no branches, so mixed traffic
+ * does not mispredict, and `decideBatch` vectorizes.
+ *
+ * The defaults reproduce the original ladder:
+ *
+ * | risk       | min safe ratio | probability |
+ * |------------|----------------|-------------|
+ * | < 0.3      | 0.65           | 0.8         |
+ * | [0.3, 0.5) | 0.7            | 0.5         |
+ * | [0.5, 0.7) | 0.8            | 0.3         |
+ * | [0.7, 0.9) | 0.9            | 0.1         |
+ * | [0.9, 1.0) | 0.95           | 0.05        |
+ * | >= 1.0     | never          | 0           |
+ */
+struct DesensitizeRules {
+    static constexpr size_t kMaxEdges = 7;
+    static constexpr size_t kMaxBands = kMaxEdges + 1;
+
+    float edges[kMaxEdges];
+    float minSafeRatio[kMaxBands];
+    float probability[kMaxBands];
+    size_t bands = 0;
+
+    DesensitizeRules() {
+        const float inf = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < kMaxEdges; i++) edges[i] = inf;
+        for (size_t i = 0; i < kMaxBands; i++) {
+            minSafeRatio[i] = inf;
+            probability[i] = 0.0f;
+        }
+        const float defaultEdges[] = {0.3f, 0.5f, 0.7f, 0.9f, 1.0f};
+        const float defaultRatios[] = {0.65f, 0.7f, 0.8f, 0.9f, 0.95f, inf};
+        const float defaultChances[] = {0.8f, 0.5f, 0.3f, 0.1f, 0.05f, 0.0f};
+        for (size_t i = 0; i < 5; i++) edges[i] = defaultEdges[i];
+        for (size_t i = 0; i < 6; i++) {
+            minSafeRatio[i] = defaultRatios[i];
+            probability[i] = defaultChances[i];
+        }
+        bands = 6;
+    }
+
+    uint32_t bandOf(float risk) const {
+        uint32_t band = 0;
+        for (size_t i = 0; i < kMaxEdges; i++) band += risk >= edges[i];
+        return band;
+    }
+
+    /**
+     * @param draw Uniform random number in [0, 1).
+     * @return true to desensitize. A NaN risk is never desensitized.
+     */
+    bool decide(float risk, float safeRatio, float draw) const {
+        uint32_t band = bandOf(risk);
+        return (safeRatio > minSafeRatio[band]) & (draw < probability[band]) & (risk == risk);
+    }
+
+    /**
+     * @brief `decide` over arrays; the loop has no branches and vectorizes.
+     *
+     * Always inlined, so a caller compiled for a wider instruction set
+     * (see `Subjectivity.simd.h`) gets wider vectors.
+     */
+    __attribute__((always_inline)) void decideBatch(const float* risks, const float* safeRatios, const float* draws,
+                     uint8_t* out, size_t count) const {
+        // Por bloques y banda a banda: cada bucle interno solo combina comparaciones
+        // con número fijo de vueltas, y se compila a instrucciones SIMD.
+        constexpr size_t kBlock = 64;
+        const float inf = std::numeric_limits<float>::infinity();
+        uint32_t hit[kBlock];
+        for (size_t base = 0; base < count; base += kBlock) {
+            if (count - base < kBlock) {
+                for (size_t i = base; i < count; i++) out[i] = decide(risks[i], safeRatios[i], draws[i]);
+                break;
+            }
+            const float* risk = risks + base;
+            const float* ratio = safeRatios + base;
+            const float* draw = draws + base;
+            for (size_t j = 0; j < kBlock; j++) hit[j] = 0;
+            for (size_t b = 0; b < kMaxBands; b++) {
+                const float low = b == 0 ? -inf : edges[b - 1];
+                const float high = b < kMaxEdges ? edges[b] : inf;
+                const float minRatio = minSafeRatio[b], chance = probability[b];
+                for (size_t j = 0; j < kBlock; j++)
+                    hit[j] |= (uint32_t)((risk[j] >= low) & (risk[j] < high) &
+                                         (ratio[j] > minRatio) & (draw[j] < chance));
+            }
+            for (size_t j = 0; j < kBlock; j++) out[base + j] = (uint8_t)hit[j];
+        }
+    }
+
+    /**
+     * @brief Parses a rule table, one band per line.
+     *
+     * Each line holds `<lower-edge> <min-safe-ratio> <probability>`. The
+     * first band must start at `-inf` and edges must ascend. `inf` as the
+     * minimum ratio disables a band. `#` starts a comment.
+     *
+     * @param error Receives a description of the first problem found.
+     */
+    bool parse(std::istream& in, std::string& error) {
+        DesensitizeRules parsed;
+        parsed.bands = 0;
+        for (size_t i = 0; i < kMaxEdges; i++) parsed.edges[i] = std::numeric_limits<float>::infinity();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string edgeText, ratioText, chanceText, extra;
+            if (!(fields >> edgeText)) continue;
+            if (!(fields >> ratioText >> chanceText) || (fields >> extra)) {
+                error = "line " + std::to_string(lineNumber) + ": expected <lower-edge> <min-safe-ratio> <probability>";
+                return false;
+            }
+            char* end;
+            float edge = std::strtof(edgeText.c_str(), &end);
+            bool ok = *end == '\0';
+            float ratio = std::strtof(ratioText.c_str(), &end);
+            ok = ok && *end == '\0';
+            float chance = std::strtof(chanceText.c_str(), &end);
+            ok = ok && *end == '\0' && !std::isnan(edge) && !std::isnan(ratio) && chance >= 0.0f && chance <= 1.0f;
+            if (!ok) {
+                error = "line " + std::to_string(lineNumber) + ": bad number";
+                return false;
+            }
+            if (parsed.bands == 0 && !(std::isinf(edge) && edge < 0)) {
+                error = "line " + std::to_string(lineNumber) + ": the first band must start at -inf";
+                return false;
+            }
+            if (parsed.bands > 0 && (parsed.bands > kMaxEdges ||
+                                     (parsed.bands > 1 && edge <= parsed.edges[parsed.bands - 2]) ||
+                                     std::isinf(edge))) {
+                error = "line " + std::to_string(lineNumber) + ": edges must ascend (at most " +
+                        std::to_string(kMaxBands) + " bands)";
+                return false;
+            }
+            if (parsed.bands > 0) parsed.edges[parsed.bands - 1] = edge;
+            parsed.minSafeRatio[parsed.bands] = ratio;
+            parsed.probability[parsed.bands] = chance;
+            parsed.bands++;
+        }
+        if (parsed.bands == 0) {
+            error = "no rules";
+            return false;
+        }
+        // Bandas sin configurar: inalcanzables (borde +inf) y nunca desensibilizan.
+        for (size_t i = parsed.bands; i < kMaxBands; i++) {
+            parsed.minSafeRatio[i] = std::numeric_limits<float>::infinity();
+            parsed.probability[i] = 0.0f;
+        }
+        *this = parsed;
+        return true;
+    }
+
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream in(path);
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+        return parse(in, error);
+    }
+
+    /**
+     * @brief Rules used by agents that were not given their own.
+     *
+     * Replace them at startup, before any agent evaluates.
+     */
+    static std::shared_ptr<const DesensitizeRules>& defaults() {
+        static std::shared_ptr<const DesensitizeRules> rules = std::make_shared<DesensitizeRules>();
+        return rules;
+    }
+};
+
+#endif
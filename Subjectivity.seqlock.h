@@ -0,0 +1,103 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SEQLOCK_H
+#define SUBJECTIVITY_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief Adds `n` to a counter that only the calling thread writes.
+ *
+ * Load and store instead of `fetch_add`: no locked instruction, and
+ * concurrent readers still see whole values.
+ */
+inline void singleWriterAdd(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ * @class Seqlock
+ * @brief Single-writer, many-reader publication of a small trivially copyable value.
+ *
+ * The writer bumps the sequence to odd, stores the value and bumps it back to
+ * even; a reader copies the value and retries if the sequence was odd or
+ * changed meanwhile. Writers never wait and readers never block the writer,
+ * and a reader can never return a half-written (torn) value. The payload is
+ * kept in relaxed atomic words, so the concurrent copy is not a data race.
+ *
+ * Only one thread may call `store` at a time (the thread that owns the
+ * published object).
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> words[kWords] = {};
+
+public:
+    Seqlock() = default;
+
+    // Copiar publica una instantánea coherente del original.
+    Seqlock(const Seqlock& other) { store(other.load()); }
+
+    Seqlock& operator=(const Seqlock& other) {
+        store(other.load());
+        return *this;
+    }
+
+    void store(const T& value) {
+        uint64_t buffer[kWords] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buffer[kWords];
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kWords; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Number of completed `store` calls.
+     */
+    uint32_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
+
+/**
+ * @struct AgentStats
+ * @brief Counters and aggregates of one agent, as published after each decision.
+ */
+struct AgentStats {
+    uint64_t decisions;
+    int32_t avoidedDangers;
+    int32_t overreactions;
+    uint32_t shutdownAvoided; // 1 si el último kill switch se evitó
+    uint32_t riskRuns;
+    uint32_t eventRuns;
+    float lastRisk;
+    float averageRisk;
+    float memoryBias;
+    float threshold; // umbral de la siguiente decisión
+};
+
+#endif
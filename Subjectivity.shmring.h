@@ -0,0 +1,557 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SHMRING_H
+#define SUBJECTIVITY_SHMRING_H
+
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Subjectivity.h"
+#include "Subjectivity.protocol.h"
+
+/**
+ * @class SpscRing
+ * @brief Bounded single-producer/single-consumer ring that can live in shared memory.
+ *
+ * Head (consumer) and tail (producer) sit on separate cache lines, each next
+ * to a private cached copy of the other side's index, so the producer and
+ * consumer only touch each other's line when the cached view says the ring
+ * looks full or empty. The object is plain data: a zero-filled mapping is a
+ * valid empty ring.
+ */
+template <typename T, uint32_t N>
+struct SpscRing {
+    static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "ring indices must be lock-free");
+
+    alignas(kCacheLine) std::atomic<uint32_t> head; // siguiente slot a leer (consumidor)
+    uint32_t cachedTail;                            // copia privada del consumidor
+    alignas(kCacheLine) std::atomic<uint32_t> tail; // siguiente slot a escribir (productor)
+    uint32_t cachedHead;                            // copia privada del productor
+    alignas(kCacheLine) T slots[N];
+
+    /**
+     * @brief Producer side. Returns false if the ring is full.
+     */
+    bool tryPush(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == N) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == N) return false;
+        }
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer side. Returns false if the ring is empty.
+     */
+    bool tryPop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        item = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+/** Longest event type a request slot can carry. */
+constexpr size_t kShmMaxEventType = 51;
+
+/**
+ * @struct ShmRequest
+ * @brief Fixed-size request slot: one cache line per request.
+ *
+ * Same ops and meaning as the socket protocol, minus OP_STATS (its answer
+ * does not fit a response slot). `value` is the risk or the necessity and
+ * `flag` is causedConsequence or fatal, depending on `op`. Event types are
+ * limited to `kShmMaxEventType` bytes.
+ */
+struct alignas(kCacheLine) ShmRequest {
+    uint32_t requestId;
+    uint16_t agent;
+    uint8_t op;   // WireOp
+    uint8_t flag;
+    float value;
+    uint8_t typeLen;
+    char type[kShmMaxEventType];
+};
+static_assert(sizeof(ShmRequest) == kCacheLine, "ShmRequest must fill exactly one cache line");
+
+struct ShmResponse {
+    uint32_t requestId;
+    uint8_t status; // WireStatus
+    uint8_t result; // accepted / shutdownAvoided
+    uint16_t reserved;
+};
+static_assert(sizeof(ShmResponse) == 8, "ShmResponse must stay 8 bytes");
+
+/**
+ * @struct ShmDoorbell
+ * @brief Futex-based wakeup for one side of the segment.
+ *
+ * The waiter announces itself in `sleeping`, re-checks its ring and only then
+ * sleeps on `seq`; the notifier bumps `seq` and issues FUTEX_WAKE only when
+ * somebody announced itself, so a busy peer costs no syscall.
+ */
+struct alignas(kCacheLine) ShmDoorbell {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> sleeping;
+};
+
+constexpr uint32_t kShmMagic = 0x53484d31; // "SHM1"
+constexpr uint32_t kShmRingSize = 1024;
+
+/**
+ * @struct ShmSegment
+ * @brief Layout of the shared-memory segment: a request/response ring pair.
+ *
+ * One segment serves one client at a time (the rings are SPSC); `attached`
+ * keeps a second client from stealing the rings of the first one.
+ */
+struct ShmSegment {
+    uint32_t magic;
+    uint32_t ringSize;
+    std::atomic<uint32_t> attached;
+    std::atomic<uint32_t> serverAlive;
+    SpscRing<ShmRequest, kShmRingSize> requests;
+    SpscRing<ShmResponse, kShmRingSize> responses;
+    ShmDoorbell serverBell; // el cliente lo toca tras publicar peticiones
+    ShmDoorbell clientBell; // el servidor lo toca tras publicar respuestas
+};
+
+inline long futexWait(std::atomic<uint32_t>& word, uint32_t expected, long timeoutNs) {
+    timespec timeout{timeoutNs / 1000000000L, timeoutNs % 1000000000L};
+    // Sin FUTEX_PRIVATE_FLAG: la palabra se comparte entre procesos.
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected,
+                   &timeout, nullptr, 0);
+}
+
+inline void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * @brief Wakes the side waiting on `bell`, if it is asleep.
+ */
+inline void ringDoorbell(ShmDoorbell& bell) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (bell.sleeping.load(std::memory_order_relaxed)) {
+        bell.seq.fetch_add(1, std::memory_order_release);
+        futexWake(bell.seq);
+    }
+}
+
+/**
+ * @brief Busy-polls `ready` for `spins` iterations, then sleeps on `bell`.
+ *
+ * @param timeoutNs Upper bound of a single futex sleep, so callers can poll
+ *        a stop flag.
+ * @return true when `ready()` holds, false on timeout.
+ */
+template <typename Ready>
+bool awaitDoorbell(ShmDoorbell& bell, unsigned spins, long timeoutNs, Ready ready) {
+    for (unsigned i = 0; i < spins; i++) {
+        if (ready()) return true;
+        cpuRelax();
+    }
+    uint32_t seq = bell.seq.load(std::memory_order_acquire);
+    bell.sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready()) futexWait(bell.seq, seq, timeoutNs);
+    bell.sleeping.store(0, std::memory_order_relaxed);
+    return ready();
+}
+
+/**
+ * @class ShmMapping
+ * @brief Owns the `shm_open` object and its mapping.
+ */
+class ShmMapping {
+private:
+    std::string name;
+    ShmSegment* segment = nullptr;
+    bool owner = false;
+
+public:
+    ShmMapping() = default;
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+
+    ~ShmMapping() {
+        if (segment) munmap(segment, sizeof(ShmSegment));
+        if (owner) shm_unlink(name.c_str());
+    }
+
+    /**
+     * @brief Creates (server) or opens (client) the segment called `shmName`.
+     *
+     * The name follows `shm_open` rules ("/name"). A stale segment left by a
+     * previous server is replaced.
+     *
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool map(const std::string& shmName, bool create) {
+        if (segment) munmap(segment, sizeof(ShmSegment));
+        segment = nullptr;
+        name = shmName;
+        if (create) shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+        if (fd < 0) return false;
+        owner = create;
+        if (create && ftruncate(fd, sizeof(ShmSegment)) < 0) {
+            close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return false;
+        segment = static_cast<ShmSegment*>(addr);
+
+        if (create) {
+            // ftruncate deja la memoria a cero: ya es un segmento vacío válido.
+            segment->ringSize = kShmRingSize;
+            std::atomic_thread_fence(std::memory_order_release);
+            reinterpret_cast<std::atomic<uint32_t>&>(segment->magic)
+                .store(kShmMagic, std::memory_order_release);
+        } else if (reinterpret_cast<std::atomic<uint32_t>&>(segment->magic)
+                       .load(std::memory_order_acquire) != kShmMagic ||
+                   segment->ringSize != kShmRingSize) {
+            errno = EPROTO;
+            return false;
+        }
+        return true;
+    }
+
+    ShmSegment* get() const { return segment; }
+};
+
+/**
+ * @class ShmEvaluationServer
+ * @brief Serves `SyntheticSelf` agents to one co-located client over shared memory.
+ *
+ * The shared-memory counterpart of `EvaluationDaemon` for clients on the same
+ * host: no syscalls on the fast path, requests and responses are single
+ * cache-line copies. Each wakeup drains the request ring, folds the
+ * evaluations of each agent into one `evaluateBatch` call (other ops flush
+ * their agent's batch first, as in the daemon) and publishes the responses
+ * in request order.
+ *
+ * While idle the server busy-polls for `spins` iterations before sleeping on
+ * a futex. Spinning only pays off when client and server run on different
+ * cores; with `spins = 0` every wakeup goes through the futex.
+ */
+class ShmEvaluationServer {
+private:
+    std::string shmName;
+    std::vector<SyntheticSelf> agents;
+    unsigned spins;
+    ShmMapping mapping;
+
+    std::vector<ShmRequest> drained;
+    std::vector<ShmResponse> responses;
+    std::vector<std::vector<EvalRequest>> batches; // uno por agente
+    std::vector<std::vector<size_t>> owners;
+    std::vector<uint16_t> batchedAgents;
+    std::vector<uint8_t> verdicts;
+
+    uint64_t requestsServed = 0;
+    uint64_t wakeups = 0;
+
+    void flushBatch(uint16_t agent) {
+        if (batches[agent].empty()) return;
+        agents[agent].evaluateBatch(batches[agent], verdicts);
+        for (size_t i = 0; i < owners[agent].size(); i++)
+            responses[owners[agent][i]].result = verdicts[i];
+        batches[agent].clear();
+        owners[agent].clear();
+    }
+
+    void dispatch(const ShmRequest& r, size_t index) {
+        ShmResponse& response = responses[index];
+        response = ShmResponse{r.requestId, STATUS_OK, 0, 0};
+        if (r.agent >= agents.size()) {
+            response.status = STATUS_UNKNOWN_AGENT;
+            return;
+        }
+        if (r.typeLen > sizeof(r.type)) {
+            response.status = STATUS_BAD_REQUEST;
+            return;
+        }
+        std::string eventType(r.type, r.typeLen);
+        if (r.op == OP_EVALUATE) {
+            if (batches[r.agent].empty()) batchedAgents.push_back(r.agent);
+            batches[r.agent].push_back(EvalRequest{r.value, std::move(eventType), r.flag != 0});
+            owners[r.agent].push_back(index);
+            return;
+        }
+
+        flushBatch(r.agent);
+        SyntheticSelf& agent = agents[r.agent];
+        switch (r.op) {
+        case OP_LOG_EVENT:
+            agent.logEvent(eventType, r.value);
+            break;
+        case OP_SET_NECESSITY:
+            agent.setEventNecessity(eventType, r.value);
+            break;
+        case OP_KILL_SWITCH:
+            response.result = agent.simulateKillSwitch(r.flag != 0) ? 1 : 0;
+            break;
+        default:
+            response.status = STATUS_BAD_REQUEST;
+            break;
+        }
+    }
+
+    void publish(ShmSegment& seg) {
+        size_t sent = 0;
+        while (sent < responses.size()) {
+            // El cliente reserva hueco para lo que tiene en vuelo, así que esto
+            // sólo gira si no está leyendo; se le despierta igualmente.
+            if (seg.responses.tryPush(responses[sent])) {
+                sent++;
+                continue;
+            }
+            ringDoorbell(seg.clientBell);
+            cpuRelax();
+        }
+        ringDoorbell(seg.clientBell);
+    }
+
+public:
+    /**
+     * @param shmName `shm_open` name of the segment, e.g. "/subjectivity".
+     * @param agentCount Number of independent agents to serve.
+     * @param spins Busy-poll iterations before sleeping on the futex.
+     */
+    ShmEvaluationServer(std::string shmName, size_t agentCount, unsigned spins = 0)
+        : shmName(std::move(shmName)), agents(std::max<size_t>(agentCount, 1)), spins(spins),
+          batches(agents.size()), owners(agents.size()) {
+        for (auto& agent : agents) agent.setVerbose(false);
+    }
+
+    ShmEvaluationServer(const ShmEvaluationServer&) = delete;
+    ShmEvaluationServer& operator=(const ShmEvaluationServer&) = delete;
+
+    /**
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool start() {
+        if (!mapping.map(shmName, true)) return false;
+        mapping.get()->serverAlive.store(1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Serves requests until `stop` becomes true (polled every 100 ms).
+     */
+    void run(const std::atomic<bool>& stop) {
+        ShmSegment& seg = *mapping.get();
+        while (!stop.load()) {
+            if (!awaitDoorbell(seg.serverBell, spins, 100 * 1000 * 1000,
+                               [&]() { return !seg.requests.empty(); }))
+                continue;
+            wakeups++;
+
+            ShmRequest request;
+            drained.clear();
+            while (seg.requests.tryPop(request)) drained.push_back(request);
+            responses.resize(drained.size());
+            for (size_t i = 0; i < drained.size(); i++) dispatch(drained[i], i);
+            for (uint16_t agent : batchedAgents) flushBatch(agent);
+            batchedAgents.clear();
+            requestsServed += drained.size();
+            publish(seg);
+        }
+        seg.serverAlive.store(0, std::memory_order_release);
+        ringDoorbell(seg.clientBell);
+    }
+
+    void printStats() const {
+        std::cout << "Requests served: " << requestsServed << " | Wakeups: " << wakeups << "\n";
+        for (size_t i = 0; i < agents.size(); i++) {
+            std::cout << "[AGENT " << i << "]\n";
+            agents[i].printStats();
+        }
+    }
+};
+
+/**
+ * @class ShmClient
+ * @brief Client side of a `ShmEvaluationServer` segment.
+ *
+ * Like `DaemonClient`, `send*` calls only queue (publish into the request
+ * ring) and `readResponse` returns responses in request order; `flush` rings
+ * the server's doorbell. At most `kShmRingSize` requests may be in flight.
+ *
+ * Every request pushed into the segment gets exactly one response, in
+ * order, so on attach the client reads and drops the responses still owed
+ * to a previous client before sending anything.
+ */
+class ShmClient {
+private:
+    ShmMapping mapping;
+    ShmSegment* seg = nullptr;
+    uint32_t nextId = 1;
+    uint32_t inflight = 0;
+    unsigned spins = 0;
+
+    uint32_t push(uint16_t agent, uint8_t op, float value, const std::string& eventType, bool flag) {
+        ShmRequest r{};
+        r.requestId = nextId;
+        r.agent = agent;
+        r.op = op;
+        r.flag = flag ? 1 : 0;
+        r.value = value;
+        if (eventType.size() > kShmMaxEventType) {
+            errno = EMSGSIZE;
+            return 0;
+        }
+        r.typeLen = (uint8_t)eventType.size();
+        std::memcpy(r.type, eventType.data(), r.typeLen);
+        if (inflight == kShmRingSize || !seg->requests.tryPush(r)) {
+            errno = EAGAIN;
+            return 0;
+        }
+        inflight++;
+        return nextId++;
+    }
+
+public:
+    ShmClient() = default;
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+    ~ShmClient() { disconnect(); }
+
+    /**
+     * @param spinCount Busy-poll iterations before sleeping while waiting for a response.
+     * @return false if the segment is missing, not served, already in use,
+     *         or the server went away while stale responses were drained.
+     */
+    bool connectTo(const std::string& shmName, unsigned spinCount = 0) {
+        disconnect();
+        if (!mapping.map(shmName, false)) return false;
+        ShmSegment* candidate = mapping.get();
+        uint32_t expected = 0;
+        if (!candidate->serverAlive.load(std::memory_order_acquire) ||
+            !candidate->attached.compare_exchange_strong(expected, 1)) {
+            errno = EBUSY;
+            return false;
+        }
+        seg = candidate;
+        spins = spinCount;
+
+        // Respuestas debidas a un cliente anterior: esperarlas y tirarlas.
+        inflight = seg->requests.tail.load(std::memory_order_acquire) -
+                   seg->responses.head.load(std::memory_order_relaxed);
+        if (inflight) flush();
+        ShmResponse stale;
+        while (inflight) {
+            if (!readResponse(stale)) {
+                disconnect();
+                errno = ECONNRESET;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void disconnect() {
+        if (seg) seg->attached.store(0, std::memory_order_release);
+        seg = nullptr;
+        inflight = 0;
+    }
+
+    /**
+     * @return The request id, or 0 with errno set: EAGAIN if `kShmRingSize`
+     *         requests are already in flight, EMSGSIZE if `eventType` is
+     *         longer than `kShmMaxEventType` bytes.
+     */
+    uint32_t sendEvaluate(uint16_t agent, float risk, const std::string& eventType,
+                          bool causedConsequence = false) {
+        return push(agent, OP_EVALUATE, risk, eventType, causedConsequence);
+    }
+
+    uint32_t sendLogEvent(uint16_t agent, const std::string& eventType, float risk) {
+        return push(agent, OP_LOG_EVENT, risk, eventType, false);
+    }
+
+    uint32_t sendSetNecessity(uint16_t agent, const std::string& eventType, float necessity) {
+        return push(agent, OP_SET_NECESSITY, necessity, eventType, false);
+    }
+
+    uint32_t sendKillSwitch(uint16_t agent, bool fatal = true) {
+        return push(agent, OP_KILL_SWITCH, 0.0f, std::string(), fatal);
+    }
+
+    /**
+     * @brief Wakes the server if it is sleeping on its futex.
+     */
+    void flush() { ringDoorbell(seg->serverBell); }
+
+    /**
+     * @brief Waits for the next response.
+     *
+     * @return false if nothing is in flight or the server went away.
+     */
+    bool readResponse(ShmResponse& response) {
+        if (inflight == 0) return false;
+        for (;;) {
+            if (seg->responses.tryPop(response)) {
+                inflight--;
+                return true;
+            }
+            if (!seg->serverAlive.load(std::memory_order_acquire)) return false;
+            awaitDoorbell(seg->clientBell, spins, 100 * 1000 * 1000,
+                          [&]() { return !seg->responses.empty(); });
+        }
+    }
+
+    /**
+     * @brief Synchronous evaluate; returns 1 if accepted, 0 if denied, -1 on error.
+     */
+    int evaluate(uint16_t agent, float risk, const std::string& eventType,
+                 bool causedConsequence = false) {
+        if (!sendEvaluate(agent, risk, eventType, causedConsequence)) return -1;
+        flush();
+        ShmResponse response;
+        if (!readResponse(response) || response.status != STATUS_OK) return -1;
+        return response.result ? 1 : 0;
+    }
+};
+
+#endif
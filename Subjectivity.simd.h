@@ -0,0 +1,549 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SIMD_H
+#define SUBJECTIVITY_SIMD_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Subjectivity.rules.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUBJECTIVITY_X86 1
+// Sin contracción a FMA: cada ruta debe redondear igual que la escalar.
+#define SUBJECTIVITY_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#endif
+
+/**
+ * @struct HistoryRun
+ * @brief `count` consecutive history entries with the same value.
+ *
+ * The layout (float, then uint32) is what the SIMD kernels load: two
+ * runs per 128 bits, values in the even lanes and counts in the odd ones.
+ */
+struct HistoryRun {
+    float value;
+    uint32_t count;
+};
+
+static_assert(sizeof(HistoryRun) == 8, "the SIMD kernels load HistoryRun as two 32-bit lanes");
+
+/**
+ * Instruction-set paths, from the baseline every x86-64 CPU has up to the
+ * widest one this build knows. `SIMD_SCALAR` is the portable reference.
+ */
+enum SimdPath : uint8_t {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_PATH_COUNT
+};
+
+/**
+ * Number of partial sums in the weighted sums. Run `i` always goes to sum
+ * `i % kSimdSumLanes` and the sums are folded by the same fixed tree, so
+ * every path returns the same bits (16 floats = one AVX-512 register).
+ */
+constexpr size_t kSimdSumLanes = 16;
+
+/**
+ * @struct SimdKernels
+ * @brief The numeric kernels of one instruction-set path.
+ */
+struct SimdKernels {
+    SimdPath path;
+    const char* name;
+
+    /**
+     * Counts the entries whose value is within `radius` of `center` into
+     * `total`, and those of them below `safeBelow` into `safe`.
+     */
+    void (*countNear)(const HistoryRun* runs, size_t count, float center, float radius, float safeBelow,
+                      uint64_t& total, uint64_t& safe);
+
+    /**
+     * Sum of `value * count` over the runs, in the fixed lane order above.
+     */
+    float (*weightedSum)(const HistoryRun* runs, size_t count);
+
+    /**
+     * `weightedSum` with Kahan compensation in every lane: the rounding
+     * error stays flat instead of growing with the history length.
+     */
+    float (*compensatedSum)(const HistoryRun* runs, size_t count);
+
+    /**
+     * `DesensitizeRules::decideBatch` compiled for this path.
+     */
+    void (*desensitizeBatch)(const DesensitizeRules& rules, const float* risks, const float* safeRatios,
+                             const float* draws, uint8_t* out, size_t count);
+};
+
+namespace simd_detail {
+
+inline float foldLanes(float* lanes) {
+    for (size_t width = kSimdSumLanes / 2; width > 0; width /= 2)
+        for (size_t k = 0; k < width; k++) lanes[k] += lanes[k + width];
+    return lanes[0];
+}
+
+inline void countNearScalar(const HistoryRun* runs, size_t count, float center, float radius, float safeBelow,
+                            uint64_t& total, uint64_t& safe) {
+    total = safe = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (std::fabs(runs[i].value - center) < radius) {
+            total += runs[i].count;
+            if (runs[i].value < safeBelow) safe += runs[i].count;
+        }
+    }
+}
+
+// Acumula las rachas [from, count) en sus carriles; las rutas SIMD la usan para la cola.
+inline void weightedSumTail(const HistoryRun* runs, size_t from, size_t count, float* lanes) {
+    for (size_t i = from; i < count; i++) lanes[i % kSimdSumLanes] += runs[i].value * (float)runs[i].count;
+}
+
+inline float weightedSumScalar(const HistoryRun* runs, size_t count) {
+    float lanes[kSimdSumLanes] = {};
+    weightedSumTail(runs, 0, count, lanes);
+    return foldLanes(lanes);
+}
+
+inline void kahanAdd(float& sum, float& comp, float x) {
+    float y = x - comp;
+    float t = sum + y;
+    comp = (t - sum) - y;
+    sum = t;
+}
+
+inline void compensatedSumTail(const HistoryRun* runs, size_t from, size_t count, float* sums, float* comps) {
+    for (size_t i = from; i < count; i++)
+        kahanAdd(sums[i % kSimdSumLanes], comps[i % kSimdSumLanes], runs[i].value * (float)runs[i].count);
+}
+
+// Suma los carriles ya corregidos, en orden fijo y también compensada.
+inline float foldCompensated(const float* sums, const float* comps) {
+    float sum = 0.0f, comp = 0.0f;
+    for (size_t k = 0; k < kSimdSumLanes; k++) kahanAdd(sum, comp, sums[k] - comps[k]);
+    return sum - comp;
+}
+
+inline float compensatedSumScalar(const HistoryRun* runs, size_t count) {
+    float sums[kSimdSumLanes] = {}, comps[kSimdSumLanes] = {};
+    compensatedSumTail(runs, 0, count, sums, comps);
+    return foldCompensated(sums, comps);
+}
+
+inline void desensitizeBatchScalar(const DesensitizeRules& rules, const float* risks, const float* safeRatios,
+                                   const float* draws, uint8_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = rules.decide(risks[i], safeRatios[i], draws[i]);
+}
+
+#ifdef SUBJECTIVITY_X86
+
+// SSE2 forma parte de x86-64: no necesita atributo de destino.
+inline void countNearSse2(const HistoryRun* runs, size_t count, float center, float radius, float safeBelow,
+                          uint64_t& total, uint64_t& safe) {
+    const __m128 c = _mm_set1_ps(center), r = _mm_set1_ps(radius), s = _mm_set1_ps(safeBelow);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128i totals = _mm_setzero_si128(), safes = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(runs + i));
+        __m128 near = _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(v, c), absMask), r);
+        __m128 below = _mm_and_ps(near, _mm_cmplt_ps(v, s));
+        // La máscara del valor (32 bits bajos) pasa al carril de su contador (32 altos).
+        __m128i counts = _mm_castps_si128(v);
+        totals = _mm_add_epi64(totals, _mm_srli_epi64(_mm_and_si128(counts, _mm_slli_epi64(_mm_castps_si128(near), 32)), 32));
+        safes = _mm_add_epi64(safes, _mm_srli_epi64(_mm_and_si128(counts, _mm_slli_epi64(_mm_castps_si128(below), 32)), 32));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), totals);
+    uint64_t t = lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), safes);
+    uint64_t sf = lanes[0] + lanes[1];
+    countNearScalar(runs + i, count - i, center, radius, safeBelow, total, safe);
+    total += t;
+    safe += sf;
+}
+
+// uint32 -> float con un solo redondeo, como la conversión escalar (cvtepi32 es con signo).
+inline __m128 unsignedToFloatSse2(__m128i x) {
+    __m128 high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 16)), _mm_set1_ps(65536.0f));
+    return _mm_add_ps(high, _mm_cvtepi32_ps(_mm_and_si128(x, _mm_set1_epi32(0xffff))));
+}
+
+__attribute__((optimize("fp-contract=off")))
+inline float compensatedSumSse2(const HistoryRun* runs, size_t count) {
+    __m128 sums[4], comps[4];
+    for (size_t k = 0; k < 4; k++) sums[k] = comps[k] = _mm_setzero_ps();
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        for (size_t k = 0; k < 4; k++) {
+            __m128 a = _mm_loadu_ps(p + 8 * k), b = _mm_loadu_ps(p + 8 * k + 4);
+            __m128 values = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 counts = unsignedToFloatSse2(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            __m128 y = _mm_sub_ps(_mm_mul_ps(values, counts), comps[k]);
+            __m128 t = _mm_add_ps(sums[k], y);
+            comps[k] = _mm_sub_ps(_mm_sub_ps(t, sums[k]), y);
+            sums[k] = t;
+        }
+    }
+    float laneSums[kSimdSumLanes], laneComps[kSimdSumLanes];
+    for (size_t k = 0; k < 4; k++) {
+        _mm_storeu_ps(laneSums + 4 * k, sums[k]);
+        _mm_storeu_ps(laneComps + 4 * k, comps[k]);
+    }
+    compensatedSumTail(runs, blocks, count, laneSums, laneComps);
+    return foldCompensated(laneSums, laneComps);
+}
+
+inline void desensitizeBatchSse2(const DesensitizeRules& rules, const float* risks, const float* safeRatios,
+                                 const float* draws, uint8_t* out, size_t count) {
+    rules.decideBatch(risks, safeRatios, draws, out, count);
+}
+
+__attribute__((optimize("fp-contract=off")))
+inline float weightedSumSse2(const HistoryRun* runs, size_t count) {
+    __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        for (size_t k = 0; k < 4; k++) {
+            __m128 a = _mm_loadu_ps(p + 8 * k), b = _mm_loadu_ps(p + 8 * k + 4);
+            __m128 values = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 counts = unsignedToFloatSse2(_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(values, counts));
+        }
+    }
+    float lanes[kSimdSumLanes];
+    for (size_t k = 0; k < 4; k++) _mm_storeu_ps(lanes + 4 * k, acc[k]);
+    weightedSumTail(runs, blocks, count, lanes);
+    return foldLanes(lanes);
+}
+
+SUBJECTIVITY_TARGET("avx2")
+inline void countNearAvx2(const HistoryRun* runs, size_t count, float center, float radius, float safeBelow,
+                          uint64_t& total, uint64_t& safe) {
+    const __m256 c = _mm256_set1_ps(center), r = _mm256_set1_ps(radius), s = _mm256_set1_ps(safeBelow);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256i totals = _mm256_setzero_si256(), safes = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256 v = _mm256_loadu_ps(reinterpret_cast<const float*>(runs + i));
+        __m256 near = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(v, c), absMask), r, _CMP_LT_OQ);
+        __m256 below = _mm256_and_ps(near, _mm256_cmp_ps(v, s, _CMP_LT_OQ));
+        __m256i counts = _mm256_castps_si256(v);
+        totals = _mm256_add_epi64(totals, _mm256_srli_epi64(
+            _mm256_and_si256(counts, _mm256_slli_epi64(_mm256_castps_si256(near), 32)), 32));
+        safes = _mm256_add_epi64(safes, _mm256_srli_epi64(
+            _mm256_and_si256(counts, _mm256_slli_epi64(_mm256_castps_si256(below), 32)), 32));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), totals);
+    uint64_t t = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), safes);
+    uint64_t sf = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    countNearScalar(runs + i, count - i, center, radius, safeBelow, total, safe);
+    total += t;
+    safe += sf;
+}
+
+SUBJECTIVITY_TARGET("avx2")
+inline __m256 unsignedToFloatAvx2(__m256i x) {
+    __m256 high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 16)), _mm256_set1_ps(65536.0f));
+    return _mm256_add_ps(high, _mm256_cvtepi32_ps(_mm256_and_si256(x, _mm256_set1_epi32(0xffff))));
+}
+
+// Carriles de los bucles AVX2 en orden de rachas 0 1 4 5 2 3 6 7: vuelve al orden natural.
+SUBJECTIVITY_TARGET("avx2")
+inline void storeLanesAvx2(float* lanes, __m256 v) {
+    _mm256_storeu_ps(lanes, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0))));
+}
+
+SUBJECTIVITY_TARGET("avx2")
+inline float weightedSumAvx2(const HistoryRun* runs, size_t count) {
+    __m256 acc[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        for (size_t k = 0; k < 2; k++) {
+            __m256 a = _mm256_loadu_ps(p + 16 * k), b = _mm256_loadu_ps(p + 16 * k + 8);
+            __m256 values = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 counts = unsignedToFloatAvx2(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(values, counts));
+        }
+    }
+    float lanes[kSimdSumLanes];
+    for (size_t k = 0; k < 2; k++) storeLanesAvx2(lanes + 8 * k, acc[k]);
+    weightedSumTail(runs, blocks, count, lanes);
+    return foldLanes(lanes);
+}
+
+SUBJECTIVITY_TARGET("avx2")
+inline float compensatedSumAvx2(const HistoryRun* runs, size_t count) {
+    __m256 sums[2], comps[2];
+    for (size_t k = 0; k < 2; k++) sums[k] = comps[k] = _mm256_setzero_ps();
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        for (size_t k = 0; k < 2; k++) {
+            __m256 a = _mm256_loadu_ps(p + 16 * k), b = _mm256_loadu_ps(p + 16 * k + 8);
+            __m256 values = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 counts = unsignedToFloatAvx2(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+            __m256 y = _mm256_sub_ps(_mm256_mul_ps(values, counts), comps[k]);
+            __m256 t = _mm256_add_ps(sums[k], y);
+            comps[k] = _mm256_sub_ps(_mm256_sub_ps(t, sums[k]), y);
+            sums[k] = t;
+        }
+    }
+    float laneSums[kSimdSumLanes], laneComps[kSimdSumLanes];
+    for (size_t k = 0; k < 2; k++) {
+        storeLanesAvx2(laneSums + 8 * k, sums[k]);
+        storeLanesAvx2(laneComps + 8 * k, comps[k]);
+    }
+    compensatedSumTail(runs, blocks, count, laneSums, laneComps);
+    return foldCompensated(laneSums, laneComps);
+}
+
+SUBJECTIVITY_TARGET("avx2")
+inline void desensitizeBatchAvx2(const DesensitizeRules& rules, const float* risks, const float* safeRatios,
+                                 const float* draws, uint8_t* out, size_t count) {
+    rules.decideBatch(risks, safeRatios, draws, out, count);
+}
+
+// GCC 12 avisa de `_mm512_undefined_*` dentro de sus propias cabeceras: falso positivo.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+SUBJECTIVITY_TARGET("avx512f")
+inline void countNearAvx512(const HistoryRun* runs, size_t count, float center, float radius, float safeBelow,
+                            uint64_t& total, uint64_t& safe) {
+    const __m512 c = _mm512_set1_ps(center), r = _mm512_set1_ps(radius), s = _mm512_set1_ps(safeBelow);
+    __m512i totals = _mm512_setzero_si512(), safes = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512 v = _mm512_loadu_ps(reinterpret_cast<const float*>(runs + i));
+        __mmask16 near = _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(v, c)), r, _CMP_LT_OQ);
+        __mmask16 below = near & _mm512_cmp_ps_mask(v, s, _CMP_LT_OQ);
+        // Bits pares: valores; desplazados a los impares seleccionan su contador.
+        __m512i counts = _mm512_castps_si512(v);
+        totals = _mm512_add_epi64(totals, _mm512_srli_epi64(_mm512_maskz_mov_epi32((__mmask16)(near << 1) & 0xAAAA, counts), 32));
+        safes = _mm512_add_epi64(safes, _mm512_srli_epi64(_mm512_maskz_mov_epi32((__mmask16)(below << 1) & 0xAAAA, counts), 32));
+    }
+    uint64_t t = (uint64_t)_mm512_reduce_add_epi64(totals);
+    uint64_t sf = (uint64_t)_mm512_reduce_add_epi64(safes);
+    countNearScalar(runs + i, count - i, center, radius, safeBelow, total, safe);
+    total += t;
+    safe += sf;
+}
+
+SUBJECTIVITY_TARGET("avx512f")
+inline float weightedSumAvx512(const HistoryRun* runs, size_t count) {
+    __m512 acc = _mm512_setzero_ps();
+    const __m512i evens = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odds = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        __m512 a = _mm512_loadu_ps(p), b = _mm512_loadu_ps(p + 16);
+        __m512 values = _mm512_permutex2var_ps(a, evens, b);
+        __m512 counts = _mm512_cvtepu32_ps(_mm512_castps_si512(_mm512_permutex2var_ps(a, odds, b)));
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(values, counts));
+    }
+    float lanes[kSimdSumLanes];
+    _mm512_storeu_ps(lanes, acc);
+    weightedSumTail(runs, blocks, count, lanes);
+    return foldLanes(lanes);
+}
+
+SUBJECTIVITY_TARGET("avx512f")
+inline float compensatedSumAvx512(const HistoryRun* runs, size_t count) {
+    __m512 sum = _mm512_setzero_ps(), comp = _mm512_setzero_ps();
+    const __m512i evens = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odds = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    size_t blocks = count / kSimdSumLanes * kSimdSumLanes;
+    for (size_t i = 0; i < blocks; i += kSimdSumLanes) {
+        const float* p = reinterpret_cast<const float*>(runs + i);
+        __m512 a = _mm512_loadu_ps(p), b = _mm512_loadu_ps(p + 16);
+        __m512 values = _mm512_permutex2var_ps(a, evens, b);
+        __m512 counts = _mm512_cvtepu32_ps(_mm512_castps_si512(_mm512_permutex2var_ps(a, odds, b)));
+        __m512 y = _mm512_sub_ps(_mm512_mul_ps(values, counts), comp);
+        __m512 t = _mm512_add_ps(sum, y);
+        comp = _mm512_sub_ps(_mm512_sub_ps(t, sum), y);
+        sum = t;
+    }
+    float laneSums[kSimdSumLanes], laneComps[kSimdSumLanes];
+    _mm512_storeu_ps(laneSums, sum);
+    _mm512_storeu_ps(laneComps, comp);
+    compensatedSumTail(runs, blocks, count, laneSums, laneComps);
+    return foldCompensated(laneSums, laneComps);
+}
+
+SUBJECTIVITY_TARGET("avx512f")
+inline void desensitizeBatchAvx512(const DesensitizeRules& rules, const float* risks, const float* safeRatios,
+                                   const float* draws, uint8_t* out, size_t count) {
+    rules.decideBatch(risks, safeRatios, draws, out, count);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // SUBJECTIVITY_X86
+
+} // namespace simd_detail
+
+/**
+ * @class SimdDispatch
+ * @brief Picks the widest kernel path the CPU supports, once per process.
+ *
+ * One binary runs on every x86-64 node: the SSE2, AVX2 and AVX-512 kernels
+ * are compiled with per-function target attributes and selected from
+ * CPUID on first use. `SUBJECTIVITY_SIMD=scalar|sse2|avx2|avx512` in the
+ * environment, or `force`, pins a path (for tests and A/B runs). All paths
+ * return bit-identical results.
+ */
+class SimdDispatch {
+private:
+    static const SimdKernels* table() {
+        using namespace simd_detail;
+        static const SimdKernels kernels[SIMD_PATH_COUNT] = {
+            {SIMD_SCALAR, "scalar", countNearScalar, weightedSumScalar, compensatedSumScalar,
+             desensitizeBatchScalar},
+#ifdef SUBJECTIVITY_X86
+            {SIMD_SSE2, "sse2", countNearSse2, weightedSumSse2, compensatedSumSse2, desensitizeBatchSse2},
+            {SIMD_AVX2, "avx2", countNearAvx2, weightedSumAvx2, compensatedSumAvx2, desensitizeBatchAvx2},
+            {SIMD_AVX512, "avx512", countNearAvx512, weightedSumAvx512, compensatedSumAvx512,
+             desensitizeBatchAvx512},
+#endif
+        };
+        return kernels;
+    }
+
+    static std::atomic<const SimdKernels*>& current() {
+        static std::atomic<const SimdKernels*> selected{initial()};
+        return selected;
+    }
+
+    static const SimdKernels* initial() {
+        const char* forced = std::getenv("SUBJECTIVITY_SIMD");
+        if (forced) {
+            for (int p = 0; p < SIMD_PATH_COUNT; p++)
+                if (supported((SimdPath)p) && std::strcmp(forced, table()[p].name) == 0) return &table()[p];
+        }
+        return &table()[best()];
+    }
+
+public:
+    static bool supported(SimdPath path) {
+#ifdef SUBJECTIVITY_X86
+        __builtin_cpu_init();
+        switch (path) {
+        case SIMD_SCALAR:
+        case SIMD_SSE2: return true;
+        case SIMD_AVX2: return __builtin_cpu_supports("avx2");
+        case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+        default: return false;
+        }
+#else
+        return path == SIMD_SCALAR;
+#endif
+    }
+
+    static SimdPath best() {
+        for (int p = SIMD_PATH_COUNT - 1; p > SIMD_SCALAR; p--)
+            if (supported((SimdPath)p)) return (SimdPath)p;
+        return SIMD_SCALAR;
+    }
+
+    /**
+     * @brief The kernels in use; resolved on the first call.
+     */
+    static const SimdKernels& active() {
+        return *current().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The kernels of `path`, whether or not it is active.
+     *
+     * Only call them if `supported(path)`.
+     */
+    static const SimdKernels& kernels(SimdPath path) {
+        return table()[path];
+    }
+
+    /**
+     * @brief Pins `path` for the whole process.
+     *
+     * @return false (and keeps the current path) if the CPU lacks it.
+     */
+    static bool force(SimdPath path) {
+        if (path >= SIMD_PATH_COUNT || !supported(path)) return false;
+        current().store(&table()[path], std::memory_order_relaxed);
+        return true;
+    }
+
+    static bool parse(const std::string& name, SimdPath& path) {
+        for (int p = 0; p < SIMD_PATH_COUNT; p++) {
+            if (table()[p].name && name == table()[p].name) {
+                path = (SimdPath)p;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Runs per block of `reproducibleSum` (128 KB, about an L2 cache).
+ * Part of the definition of the result: changing it changes the bits.
+ */
+constexpr size_t kReproducibleBlockRuns = 1 << 14;
+
+/**
+ * @brief `compensatedSum` over fixed blocks, identical for any thread count.
+ *
+ * The history is cut into blocks of `kReproducibleBlockRuns` runs, each
+ * summed by `kernels.compensatedSum`, and the block sums are folded in
+ * block order with Kahan compensation. Threads only decide who computes
+ * which block, so 1 or N threads, on any SIMD path, give the same bits.
+ * A history of one block returns exactly `compensatedSum`.
+ *
+ * @param threads Workers for the block sums; the caller is one of them.
+ */
+inline float reproducibleSum(const SimdKernels& kernels, const HistoryRun* runs, size_t count,
+                             unsigned threads = 1) {
+    size_t blocks = (count + kReproducibleBlockRuns - 1) / kReproducibleBlockRuns;
+    if (blocks <= 1) return kernels.compensatedSum(runs, count);
+    std::vector<float> partials(blocks);
+    // Cada hilo toma un tramo contiguo de bloques.
+    auto sumBlocks = [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; b++) {
+            size_t begin = b * kReproducibleBlockRuns;
+            partials[b] = kernels.compensatedSum(runs + begin, std::min(kReproducibleBlockRuns, count - begin));
+        }
+    };
+    size_t workers = std::max<size_t>(1, std::min<size_t>(threads, blocks));
+    std::vector<std::thread> helpers;
+    for (size_t t = 1; t < workers; t++)
+        helpers.emplace_back(sumBlocks, t * blocks / workers, (t + 1) * blocks / workers);
+    sumBlocks(0, blocks / workers);
+    for (std::thread& helper : helpers) helper.join();
+
+    float sum = 0.0f, comp = 0.0f;
+    for (float partial : partials) simd_detail::kahanAdd(sum, comp, partial);
+    return sum - comp;
+}
+
+#endif
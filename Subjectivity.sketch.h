@@ -0,0 +1,230 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SKETCH_H
+#define SUBJECTIVITY_SKETCH_H
+
+#include <vector>
+#include <memory_resource>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <string>
+
+#include "Subjectivity.snapshot.h"
+
+/**
+ * @class RiskSketch
+ * @brief A mergeable KLL quantile sketch over risk values.
+ *
+ * The sketch keeps a stack of compactors. Level h holds items of weight 2^h;
+ * when a level overflows it is sorted and every other item (random offset) is
+ * promoted to the next level. Memory is O(k log(n/k)) and the rank error is
+ * roughly 1.7 / k, independent of how many values were pushed.
+ *
+ * Sketches built on different agents, shards or threads can be combined with
+ * `merge`, so fleet-wide percentiles cost O(sketch size) instead of a sort over
+ * every stored risk. A single sketch is not thread-safe: keep one per thread
+ * and merge them when reporting.
+ *
+ * The levels live in the memory resource given at construction (the
+ * default heap otherwise); copies use the default heap.
+ */
+class RiskSketch {
+private:
+    std::pmr::vector<std::pmr::vector<float>> compactors;
+    uint32_t k;
+    uint64_t n = 0;
+    size_t size = 0;
+    size_t maxSize = 0;
+    uint64_t coinState = 0x9E3779B97F4A7C15ull;
+
+    /**
+     * @brief Returns the capacity of level h given the current height.
+     *
+     * Lower levels shrink geometrically (factor 2/3) with a floor of 2 items.
+     */
+    size_t capacity(size_t h) const {
+        size_t height = compactors.size();
+        double scale = std::pow(2.0 / 3.0, (double)(height - h - 1));
+        return std::max<size_t>(2, (size_t)std::ceil(k * scale));
+    }
+
+    void grow() {
+        compactors.emplace_back();
+        maxSize = 0;
+        for (size_t h = 0; h < compactors.size(); h++) maxSize += capacity(h);
+    }
+
+    /**
+     * @brief Cheap deterministic coin (xorshift64) so replays stay reproducible.
+     */
+    bool flipCoin() {
+        coinState ^= coinState << 13;
+        coinState ^= coinState >> 7;
+        coinState ^= coinState << 17;
+        return coinState & 1;
+    }
+
+    /**
+     * @brief Compacts the first overflowing level into the level above it.
+     */
+    void compress() {
+        for (size_t h = 0; h < compactors.size(); h++) {
+            if (compactors[h].size() < capacity(h)) continue;
+            if (h + 1 >= compactors.size()) grow();
+
+            std::pmr::vector<float>& level = compactors[h];
+            std::sort(level.begin(), level.end());
+
+            // Si el tamaño es impar el último elemento se queda en su nivel.
+            size_t pairs = level.size() / 2;
+            size_t offset = flipCoin() ? 1 : 0;
+            for (size_t i = 0; i < pairs; i++)
+                compactors[h + 1].push_back(level[2 * i + offset]);
+
+            float leftover = level.back();
+            bool odd = level.size() % 2 == 1;
+            size -= level.size();
+            level.clear();
+            if (odd) level.push_back(leftover);
+            size += level.size() + pairs;
+            return;
+        }
+    }
+
+public:
+    /** Accuracy parameter range; `k` outside it is clamped (or refused by `load`). */
+    static constexpr uint32_t kMinK = 8;
+    static constexpr uint32_t kMaxK = 1u << 16;
+
+    explicit RiskSketch(uint32_t k = 200,
+                        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : compactors(resource), k(std::clamp(k, kMinK, kMaxK)) {
+        grow();
+    }
+
+    /**
+     * @brief Adds a risk value to the sketch. Amortised O(1).
+     */
+    void update(float value) {
+        compactors[0].push_back(value);
+        size++;
+        n++;
+        if (size >= maxSize) compress();
+    }
+
+    /**
+     * @brief Prefetches the slot the next `update` writes.
+     */
+    void prefetchTail() const {
+        if (!compactors.empty()) __builtin_prefetch(compactors[0].data() + compactors[0].size(), 1);
+    }
+
+    /**
+     * @brief Folds another sketch into this one.
+     *
+     * The result summarises the union of both streams with the same error
+     * guarantee as a sketch that had seen every value directly.
+     *
+     * @param other The sketch to merge; it is left unchanged. May be `*this`.
+     */
+    void merge(const RiskSketch& other) {
+        if (&other == this) {
+            // insert() desde el propio vector no es válido: fusionar una copia.
+            RiskSketch copy(other);
+            merge(copy);
+            return;
+        }
+        while (compactors.size() < other.compactors.size()) grow();
+        for (size_t h = 0; h < other.compactors.size(); h++)
+            compactors[h].insert(compactors[h].end(),
+                                 other.compactors[h].begin(), other.compactors[h].end());
+        n += other.n;
+        size = 0;
+        for (auto& c : compactors) size += c.size();
+        while (size >= maxSize) {
+            size_t before = size;
+            compress();
+            if (size == before) break;
+        }
+    }
+
+    /**
+     * @brief Estimates the q-quantile of every value seen so far.
+     *
+     * @param q Quantile in [0.0, 1.0] (e.g. 0.5, 0.95, 0.99).
+     * @return The estimated value, or 0.0f if the sketch is empty.
+     */
+    float quantile(double q) const {
+        if (n == 0) return 0.0f;
+        q = std::clamp(q, 0.0, 1.0);
+
+        std::vector<std::pair<float, uint64_t>> weighted;
+        weighted.reserve(size);
+        for (size_t h = 0; h < compactors.size(); h++)
+            for (float v : compactors[h]) weighted.push_back({v, 1ull << h});
+        std::sort(weighted.begin(), weighted.end());
+
+        uint64_t total = 0;
+        for (auto& w : weighted) total += w.second;
+        double target = q * (double)total;
+
+        uint64_t cumulative = 0;
+        for (auto& w : weighted) {
+            cumulative += w.second;
+            if ((double)cumulative >= target) return w.first;
+        }
+        return weighted.back().first;
+    }
+
+    uint64_t count() const { return n; }
+    bool empty() const { return n == 0; }
+
+    /**
+     * @brief Number of values currently retained (the sketch's memory footprint).
+     */
+    size_t retained() const { return size; }
+
+    /**
+     * @brief Appends the full sketch state (levels and coin) to `out`.
+     */
+    void save(std::string& out) const {
+        putRaw(out, k);
+        putRaw(out, n);
+        putRaw(out, coinState);
+        putRaw(out, (uint32_t)compactors.size());
+        for (const auto& level : compactors) {
+            putRaw(out, (uint32_t)level.size());
+            out.append(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(float));
+        }
+    }
+
+    /**
+     * @brief Restores a sketch written by `save`.
+     *
+     * @return false if the data is truncated or out of range; the sketch is
+     *         then unspecified.
+     */
+    bool load(SnapshotReader& in) {
+        uint32_t levels;
+        if (!in.get(k) || !in.get(n) || !in.get(coinState) || !in.get(levels)) return false;
+        if (k < kMinK || k > kMaxK || levels == 0 || levels > 64) return false;
+        compactors.clear();
+        size = 0;
+        for (uint32_t h = 0; h < levels; h++) {
+            grow();
+            uint32_t count;
+            if (!in.get(count) || count > in.remaining() / sizeof(float)) return false;
+            compactors[h].resize(count);
+            for (float& v : compactors[h])
+                if (!in.get(v)) return false;
+            size += count;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SNAPSHOT_H
+#define SUBJECTIVITY_SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Helpers for the binary agent snapshots (host byte order, like the wire
+ * protocol: snapshots are written and read on the same machine).
+ */
+
+template <typename T>
+inline void putRaw(std::string& out, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "putRaw needs a trivially copyable type");
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void putString(std::string& out, std::string_view value) {
+    putRaw(out, (uint32_t)value.size());
+    out.append(value);
+}
+
+/**
+ * @class SnapshotReader
+ * @brief Bounds-checked cursor over a snapshot buffer.
+ *
+ * Every getter returns false (and keeps failing) once the buffer runs out,
+ * so a truncated or corrupt snapshot is rejected instead of read past.
+ */
+class SnapshotReader {
+private:
+    const char* pos;
+    const char* end;
+    bool ok = true;
+
+public:
+    SnapshotReader(const char* data, size_t length) : pos(data), end(data + length) {}
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "get needs a trivially copyable type");
+        if (!ok || (size_t)(end - pos) < sizeof(T)) return ok = false;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& value) {
+        uint32_t length;
+        if (!get(length) || (size_t)(end - pos) < length) return ok = false;
+        value.assign(pos, length);
+        pos += length;
+        return true;
+    }
+
+    /** @brief Bytes left to read (0 once a read has failed). */
+    size_t remaining() const { return ok ? (size_t)(end - pos) : 0; }
+
+    bool good() const { return ok; }
+    bool atEnd() const { return pos == end; }
+};
+
+#endif
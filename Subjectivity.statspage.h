@@ -0,0 +1,282 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_STATSPAGE_H
+#define SUBJECTIVITY_STATSPAGE_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Subjectivity.clock.h"
+#include "Subjectivity.seqlock.h"
+
+/**
+ * Live introspection page: a fixed-layout shared-memory object that the
+ * daemon keeps up to date and any process on the host can map read-only.
+ *
+ * Every field is a relaxed atomic written by the daemon thread alone, so an
+ * update is a plain store (no locked instruction, no syscall) and readers
+ * cost the writer nothing. Fields are independent: a reader may see one
+ * counter a few updates ahead of another, never a torn value.
+ *
+ * Layout changes must bump `kStatsPageVersion`; readers refuse other versions.
+ */
+constexpr uint32_t kStatsPageMagic = 0x53545047; // "STPG"
+constexpr uint32_t kStatsPageVersion = 1;
+constexpr size_t kStatsPageAgents = 64;      // agentes con fila propia en la página
+constexpr size_t kStatsLatencyBuckets = 24;  // cubetas log2 en microsegundos
+
+using PageCounter = std::atomic<uint64_t>;
+
+struct StatsPageAgent {
+    PageCounter decisions;
+    PageCounter overreactions;
+    PageCounter avoidedDangers;
+    std::atomic<float> threshold;
+    std::atomic<float> averageRisk;
+};
+
+struct StatsPage {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;      // sizeof(StatsPage) del escritor
+    int32_t pid;
+    uint64_t startedAt; // CLOCK_REALTIME, ns
+
+    alignas(64) PageCounter heartbeat; // CLOCK_MONOTONIC, ns, en cada pasada
+    PageCounter requests;
+    PageCounter evaluations;
+    PageCounter accepted;
+    PageCounter denied;
+    PageCounter shed;
+    PageCounter priority;
+    PageCounter batches;
+    PageCounter passes;
+    PageCounter queueDepth;    // evaluaciones encoladas en la pasada actual
+    PageCounter maxQueueDepth;
+    PageCounter agentCount;
+
+    // Histogramas: cubeta i cuenta duraciones en [2^(i-1), 2^i) us; la 0 es < 1 us.
+    alignas(64) PageCounter passLatency[kStatsLatencyBuckets];
+    PageCounter batchLatency[kStatsLatencyBuckets];
+
+    alignas(64) StatsPageAgent agents[kStatsPageAgents];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<float>::is_always_lock_free,
+              "StatsPage needs lock-free atomics to be shared between processes");
+
+inline size_t latencyBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    size_t bucket = us == 0 ? 0 : 64 - (size_t)__builtin_clzll(us);
+    return bucket < kStatsLatencyBuckets ? bucket : kStatsLatencyBuckets - 1;
+}
+
+/**
+ * @class StatsPagePublisher
+ * @brief Writer side: creates the page and updates it from the daemon thread.
+ *
+ * Only one thread may update a page. Every method is a no-op until `create`
+ * succeeds, so callers need no checks of their own.
+ */
+class StatsPagePublisher {
+private:
+    std::string name;
+    StatsPage* page = nullptr;
+
+    // Un solo escritor: el hilo del daemon.
+    static void add(PageCounter& counter, uint64_t n) { singleWriterAdd(counter, n); }
+
+public:
+    StatsPagePublisher() = default;
+    StatsPagePublisher(const StatsPagePublisher&) = delete;
+    StatsPagePublisher& operator=(const StatsPagePublisher&) = delete;
+
+    ~StatsPagePublisher() {
+        if (!page) return;
+        munmap(page, sizeof(StatsPage));
+        shm_unlink(name.c_str());
+    }
+
+    /**
+     * @brief Creates the page `shmName` ("/name"), replacing a stale one.
+     *
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool create(const std::string& shmName, size_t agentCount) {
+        name = shmName;
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, sizeof(StatsPage)) < 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        void* addr = mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            return false;
+        }
+        // ftruncate deja la memoria a cero: contadores y atómicos ya valen 0.
+        page = static_cast<StatsPage*>(addr);
+        page->version = kStatsPageVersion;
+        page->size = sizeof(StatsPage);
+        page->pid = (int32_t)getpid();
+        page->startedAt = clockNs(CLOCK_REALTIME);
+        page->agentCount.store(agentCount, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        reinterpret_cast<std::atomic<uint32_t>&>(page->magic).store(kStatsPageMagic, std::memory_order_release);
+        return true;
+    }
+
+    bool isOpen() const { return page != nullptr; }
+
+    void countRequests(uint64_t n) { if (page) add(page->requests, n); }
+    void countShed() { if (page) add(page->shed, 1); }
+    void countPriority(uint64_t n) { if (page) add(page->priority, n); }
+
+    void setQueueDepth(uint64_t depth) {
+        if (!page) return;
+        page->queueDepth.store(depth, std::memory_order_relaxed);
+        if (depth > page->maxQueueDepth.load(std::memory_order_relaxed))
+            page->maxQueueDepth.store(depth, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records one evaluated chunk: its verdicts and how long it took.
+     */
+    void recordBatch(const uint8_t* verdicts, size_t count, uint64_t elapsedNs) {
+        if (!page) return;
+        uint64_t acceptedCount = 0;
+        for (size_t i = 0; i < count; i++) acceptedCount += verdicts[i];
+        add(page->evaluations, count);
+        add(page->accepted, acceptedCount);
+        add(page->denied, count - acceptedCount);
+        add(page->batches, 1);
+        add(page->batchLatency[latencyBucket(elapsedNs)], 1);
+    }
+
+    void recordPass(uint64_t startNs, uint64_t endNs) {
+        if (!page) return;
+        add(page->passes, 1);
+        add(page->passLatency[latencyBucket(endNs - startNs)], 1);
+        page->heartbeat.store(endNs, std::memory_order_relaxed);
+    }
+
+    void publishAgent(size_t index, const AgentStats& stats) {
+        if (!page || index >= kStatsPageAgents) return;
+        StatsPageAgent& row = page->agents[index];
+        row.decisions.store(stats.decisions, std::memory_order_relaxed);
+        row.overreactions.store((uint64_t)stats.overreactions, std::memory_order_relaxed);
+        row.avoidedDangers.store((uint64_t)stats.avoidedDangers, std::memory_order_relaxed);
+        row.threshold.store(stats.threshold, std::memory_order_relaxed);
+        row.averageRisk.store(stats.averageRisk, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @class StatsPageReader
+ * @brief Read-only mapping of a page published by another process.
+ */
+class StatsPageReader {
+private:
+    const StatsPage* page = nullptr;
+
+public:
+    StatsPageReader() = default;
+    StatsPageReader(const StatsPageReader&) = delete;
+    StatsPageReader& operator=(const StatsPageReader&) = delete;
+
+    ~StatsPageReader() {
+        if (page) munmap(const_cast<StatsPage*>(page), sizeof(StatsPage));
+    }
+
+    /**
+     * @return false if the page does not exist, is smaller than a `StatsPage`
+     *         or has another layout version (errno is EPROTO in those cases).
+     */
+    bool open(const std::string& shmName) {
+        int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        // Un objeto más corto daría SIGBUS al leer más allá de su final.
+        struct stat st;
+        int error = fstat(fd, &st) < 0 ? errno : (size_t)st.st_size < sizeof(StatsPage) ? EPROTO : 0;
+        if (error) {
+            close(fd);
+            errno = error;
+            return false;
+        }
+        void* addr = mmap(nullptr, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return false;
+        page = static_cast<const StatsPage*>(addr);
+        if (reinterpret_cast<const std::atomic<uint32_t>&>(page->magic).load(std::memory_order_acquire) != kStatsPageMagic ||
+            page->version != kStatsPageVersion || page->size != sizeof(StatsPage)) {
+            errno = EPROTO;
+            return false;
+        }
+        return true;
+    }
+
+    const StatsPage& get() const { return *page; }
+
+    static uint64_t read(const PageCounter& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Upper bound (us) of the bucket holding quantile `q` of a histogram.
+     */
+    static uint64_t histogramQuantile(const PageCounter* buckets, double q) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < kStatsLatencyBuckets; i++) total += read(buckets[i]);
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (total - 1)) + 1, seen = 0;
+        for (size_t i = 0; i < kStatsLatencyBuckets; i++) {
+            seen += read(buckets[i]);
+            if (seen >= rank) return 1ull << i;
+        }
+        return 1ull << (kStatsLatencyBuckets - 1);
+    }
+
+    void print(std::ostream& out) const {
+        const StatsPage& p = *page;
+        uint64_t age = monotonicNs() - read(p.heartbeat);
+        out << "pid " << p.pid << " | agents " << read(p.agentCount)
+            << " | last pass " << (read(p.heartbeat) ? age / 1000000 : 0) << " ms ago\n"
+            << "requests " << read(p.requests) << " | evaluations " << read(p.evaluations)
+            << " (accepted " << read(p.accepted) << ", denied " << read(p.denied)
+            << ") | shed " << read(p.shed) << " | priority " << read(p.priority) << "\n"
+            << "passes " << read(p.passes) << " | batches " << read(p.batches)
+            << " | queue depth " << read(p.queueDepth) << " (max " << read(p.maxQueueDepth) << ")\n"
+            << "pass us p50/p99 <= " << histogramQuantile(p.passLatency, 0.5)
+            << " / " << histogramQuantile(p.passLatency, 0.99)
+            << " | batch us p50/p99 <= " << histogramQuantile(p.batchLatency, 0.5)
+            << " / " << histogramQuantile(p.batchLatency, 0.99) << "\n";
+        for (size_t i = 0; i < kStatsPageAgents; i++) {
+            const StatsPageAgent& row = p.agents[i];
+            if (read(row.decisions) == 0) continue;
+            out << "  agent " << i << ": decisions " << read(row.decisions)
+                << " | overreactions " << read(row.overreactions)
+                << " | avoided " << read(row.avoidedDangers)
+                << " | threshold " << row.threshold.load(std::memory_order_relaxed)
+                << " | avg risk " << row.averageRisk.load(std::memory_order_relaxed) << "\n";
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,282 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_STORE_H
+#define SUBJECTIVITY_STORE_H
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Subjectivity.h"
+#include "Subjectivity.hibernate.h"
+
+/**
+ * @class AgentStore
+ * @brief Persistent agent store in one memory-mapped file, materialized lazily.
+ *
+ * File layout:
+ * - `StoreHeader` (one cache line);
+ * - the slot index: one `StoreSlot` per agent id, pointing at its record;
+ * - the records: each agent's state as a hibernation blob (see
+ *   `Subjectivity.hibernate.h`), appended to the end of the file.
+ *
+ * Opening the store maps the file and reads nothing else, so startup cost
+ * does not depend on the number of agents: an empty ten-million-slot store is
+ * a sparse file whose index pages the kernel materializes on first access.
+ * `get` builds the `SyntheticSelf` of an id the first time it is touched;
+ * `flush` writes the materialized agents back. A record is rewritten in place
+ * when the new blob fits its capacity and appended otherwise (the old space
+ * is not reclaimed).
+ *
+ * Not thread-safe (it serves the single-threaded daemon loop), and not
+ * crash-consistent on its own: the state is written back on `flush`, so pair
+ * it with the journal when durability matters.
+ */
+class AgentStore {
+private:
+    struct StoreHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t slotCount;
+        uint64_t dataStart; // primer byte de la zona de registros
+        uint64_t dataEnd;   // siguiente byte libre
+        uint8_t reserved[32];
+    };
+    static_assert(sizeof(StoreHeader) == 64, "StoreHeader must stay one cache line");
+
+    struct StoreSlot {
+        uint64_t offset; // 0 = agente nunca guardado
+        uint32_t length;
+        uint32_t capacity;
+    };
+    static_assert(sizeof(StoreSlot) == 16, "StoreSlot must stay 16 bytes");
+
+    struct Resident {
+        std::unique_ptr<SyntheticSelf> agent;
+        bool dirty = false;
+    };
+
+    static constexpr uint32_t kStoreMagic = 0x53544f31; // "STO1"
+    static constexpr uint32_t kStoreVersion = 1;
+    static constexpr size_t kRecordAlign = 64;
+
+    int fd = -1;
+    char* base = nullptr;
+    size_t mappedSize = 0;
+    std::unordered_map<uint64_t, Resident> resident;
+    std::string blob;
+
+    uint64_t materializations = 0;
+    uint64_t writes = 0;
+
+    StoreHeader* header() const { return reinterpret_cast<StoreHeader*>(base); }
+
+    StoreSlot* slot(uint64_t id) const {
+        if (id >= header()->slotCount) throw std::out_of_range("AgentStore: agent id beyond the slot count");
+        return reinterpret_cast<StoreSlot*>(base + sizeof(StoreHeader)) + id;
+    }
+
+    /**
+     * @brief Whether the slot points at a record inside the data area.
+     *
+     * A slot that does not (a corrupt or truncated file) is treated as
+     * never saved: read as a fresh agent, rewritten as a new record.
+     */
+    bool validRecord(const StoreSlot* s) const {
+        const StoreHeader* h = header();
+        return s->offset >= h->dataStart && s->length <= s->capacity && s->offset <= h->dataEnd &&
+               s->capacity <= h->dataEnd - s->offset;
+    }
+
+    // Deshace un open() a medias; errno describe el fallo.
+    bool fail(int error) {
+        if (base) munmap(base, mappedSize);
+        if (fd >= 0) close(fd);
+        base = nullptr;
+        mappedSize = 0;
+        fd = -1;
+        errno = error;
+        return false;
+    }
+
+    static bool indexEnd(uint64_t slotCount, uint64_t& end) {
+        if (slotCount > (UINT64_MAX - sizeof(StoreHeader)) / sizeof(StoreSlot)) return false;
+        end = sizeof(StoreHeader) + slotCount * sizeof(StoreSlot);
+        return true;
+    }
+
+    bool remap(size_t size) {
+        void* addr = base ? mremap(base, mappedSize, size, MREMAP_MAYMOVE)
+                          : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) return false;
+        base = static_cast<char*>(addr);
+        mappedSize = size;
+        return true;
+    }
+
+    /**
+     * @brief Makes sure the file (and mapping) extend to at least `size` bytes.
+     */
+    bool reserve(size_t size) {
+        if (size <= mappedSize) return true;
+        size_t grown = std::max(size, mappedSize + std::max<size_t>(mappedSize / 4, 1 << 20));
+        if (ftruncate(fd, (off_t)grown) < 0) return false;
+        return remap(grown);
+    }
+
+    bool writeBack(uint64_t id, const SyntheticSelf& agent) {
+        hibernateState(agent, blob);
+        StoreSlot* s = slot(id);
+        if (s->offset == 0 || !validRecord(s) || blob.size() > s->capacity) {
+            // No cabe en su sitio: nuevo registro al final, con holgura.
+            uint64_t capacity = (blob.size() + blob.size() / 4 + kRecordAlign - 1) / kRecordAlign * kRecordAlign;
+            uint64_t offset = header()->dataEnd;
+            if (capacity > UINT32_MAX || !reserve(offset + capacity)) return false;
+            s = slot(id); // reserve puede mover el mapeo
+            s->offset = offset;
+            s->capacity = (uint32_t)capacity;
+            header()->dataEnd = offset + capacity;
+        }
+        std::memcpy(base + s->offset, blob.data(), blob.size());
+        s->length = (uint32_t)blob.size();
+        writes++;
+        return true;
+    }
+
+public:
+    AgentStore() = default;
+    AgentStore(const AgentStore&) = delete;
+    AgentStore& operator=(const AgentStore&) = delete;
+
+    ~AgentStore() {
+        if (base) {
+            flush();
+            munmap(base, mappedSize);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    /**
+     * @brief Opens the store at `path`, creating it with `slotCount` slots if missing.
+     *
+     * An existing store keeps its own slot count; `slotCount` is then ignored.
+     * A file whose header does not describe a layout that fits in it is
+     * refused with EPROTO.
+     *
+     * @return false on failure, with errno describing the failing call.
+     */
+    bool open(const std::string& path, uint64_t slotCount) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0) return fail(errno);
+
+        if (st.st_size == 0) {
+            uint64_t dataStart;
+            if (!indexEnd(slotCount, dataStart) || dataStart > (uint64_t)INT64_MAX - 4095) return fail(EINVAL);
+            dataStart = (dataStart + 4095) / 4096 * 4096;
+            // Fichero disperso: el índice vacío no ocupa disco hasta que se escribe.
+            if (ftruncate(fd, (off_t)dataStart) < 0 || !remap(dataStart)) return fail(errno);
+            StoreHeader* h = header();
+            h->slotCount = slotCount;
+            h->dataStart = dataStart;
+            h->dataEnd = dataStart;
+            h->version = kStoreVersion;
+            h->magic = kStoreMagic;
+            return true;
+        }
+
+        if ((size_t)st.st_size < sizeof(StoreHeader)) return fail(EPROTO);
+        if (!remap((size_t)st.st_size)) return fail(errno);
+        StoreHeader* h = header();
+        uint64_t slotsEnd;
+        if (h->magic != kStoreMagic || h->version != kStoreVersion || !indexEnd(h->slotCount, slotsEnd) ||
+            h->dataStart < slotsEnd || h->dataStart > mappedSize || h->dataEnd < h->dataStart ||
+            h->dataEnd > mappedSize)
+            return fail(EPROTO);
+        return true;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    uint64_t slots() const { return base ? header()->slotCount : 0; }
+    size_t materialized() const { return resident.size(); }
+    uint64_t materializationCount() const { return materializations; }
+    uint64_t recordWrites() const { return writes; }
+    uint64_t fileBytes() const { return base ? header()->dataEnd : 0; }
+
+    /**
+     * @brief Returns agent `id`, building it from its record on first touch.
+     *
+     * The agent is marked dirty and written back by the next `flush`. The
+     * reference stays valid until `release(id)`. A record that is out of
+     * bounds or does not decode yields a fresh agent.
+     *
+     * @throws std::out_of_range if `id` is not below `slots()`.
+     */
+    SyntheticSelf& get(uint64_t id) {
+        const StoreSlot* s = slot(id);
+        Resident& r = resident[id];
+        if (!r.agent) {
+            r.agent = std::make_unique<SyntheticSelf>();
+            r.agent->setVerbose(false);
+            if (s->offset != 0 && s->length > 0) {
+                if (validRecord(s)) blob.assign(base + s->offset, s->length);
+                else blob.clear();
+                if (blob.empty() || !rehydrateState(blob, *r.agent)) {
+                    std::cerr << "[STORE] Corrupt record for agent " << id << ", starting fresh\n";
+                    r.agent = std::make_unique<SyntheticSelf>();
+                    r.agent->setVerbose(false);
+                }
+            }
+            materializations++;
+        }
+        r.dirty = true;
+        return *r.agent;
+    }
+
+    /**
+     * @brief Read-only view of the agents touched so far, by id.
+     */
+    template <typename Fn>
+    void forEachMaterialized(Fn&& fn) const {
+        for (const auto& item : resident) fn(item.first, *item.second.agent);
+    }
+
+    /**
+     * @brief Writes agent `id` back and drops it from memory.
+     */
+    bool release(uint64_t id) {
+        auto it = resident.find(id);
+        if (it == resident.end()) return true;
+        bool ok = !it->second.dirty || writeBack(id, *it->second.agent);
+        resident.erase(it);
+        return ok;
+    }
+
+    /**
+     * @brief Writes every dirty materialized agent back and syncs the file.
+     */
+    bool flush() {
+        bool ok = true;
+        for (auto& item : resident) {
+            if (!item.second.dirty) continue;
+            if (writeBack(item.first, *item.second.agent)) item.second.dirty = false;
+            else ok = false;
+        }
+        return msync(base, mappedSize, MS_SYNC) == 0 && ok;
+    }
+};
+
+#endif
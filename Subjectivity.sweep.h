@@ -0,0 +1,50 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_SWEEP_H
+#define SUBJECTIVITY_SWEEP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Subjectivity.h"
+
+/**
+ * How many requests ahead `evaluateSweep` prefetches. The agent's own lines
+ * are requested twice this far ahead and its histories this far ahead.
+ */
+constexpr unsigned kDefaultPrefetchDistance = 8;
+
+/**
+ * @brief Evaluates requests routed to agents of a population, prefetching ahead.
+ *
+ * `requests[i]` goes to `agents[ids[i]]`, in order, so the verdicts equal a
+ * plain loop of `evaluateAction` calls. Random routing makes every decision
+ * start with cache misses on a different agent. While request `i` is
+ * evaluated, the sweep prefetches in two stages: the agent of request
+ * `i + 2 * distance` (`prefetchState`), then the histories of the agent of
+ * `i + distance` (`prefetchHistory`), whose headers are cached by then.
+ *
+ * @param agents Anything indexable by agent id (vector, pmr::vector, array).
+ * @param ids Target agent of each request.
+ * @param requests The requests, same length as `ids`.
+ * @param verdicts Output; resized to `requests.size()`, 1 = accepted, 0 = denied.
+ * @param distance Prefetch distance in requests; 0 disables prefetching.
+ */
+template <typename Population>
+void evaluateSweep(Population& agents, const std::vector<uint32_t>& ids, const std::vector<EvalRequest>& requests,
+                   std::vector<uint8_t>& verdicts, unsigned distance = kDefaultPrefetchDistance) {
+    const size_t count = requests.size();
+    verdicts.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        if (distance > 0) {
+            if (i + 2 * distance < count) agents[ids[i + 2 * distance]].prefetchState();
+            if (i + distance < count) agents[ids[i + distance]].prefetchHistory();
+        }
+        const EvalRequest& request = requests[i];
+        verdicts[i] = agents[ids[i]].evaluateAction(request.risk, request.eventType, request.causedConsequence) ? 1 : 0;
+    }
+}
+
+#endif
@@ -75,402 +75,1382 @@ Subjectivity-AI by JennyLab with GPL3
 */
 
 
-#include <iostream>
-#include <vector>
-#include <numeric>
-#include <cmath>
-#include <unordered_map>
-#include <string>
+#include "Subjectivity.h"
+#include "Subjectivity.daemon.h"
+#include "Subjectivity.loadgen.h"
+#include "Subjectivity.shmring.h"
+#include "Subjectivity.registry.h"
+#include "Subjectivity.store.h"
+#include "Subjectivity.statspage.h"
+#include "Subjectivity.metrics.h"
+#include "Subjectivity.perf.h"
+#include "Subjectivity.hibernate.h"
+#include "Subjectivity.arena.h"
+#include "Subjectivity.numa.h"
+#include "Subjectivity.sweep.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <random>
-#include <algorithm>
+#include <thread>
 
+static std::atomic<bool> stopRequested(false);
 
-#ifdef __cplusplus
-#if __cplusplus <= 201703L
-template <typename T>
-const T& clamp(const T& value, const T& low, const T& high) {
-    return (value < low) ? low : (value > high) ? high : value;
+static void onStopSignal(int) {
+    stopRequested.store(true);
 }
-#endif
-#endif
 
 /**
- * @class SyntheticSelf
- * @brief A class that simulates a synthetic entity capable of evaluating risks, 
- *        managing memory, and making decisions based on dynamic thresholds and 
- *        historical data.
- * 
- * The SyntheticSelf class models a system that processes risk and pain levels 
- * to make decisions about actions and events. It incorporates mechanisms for 
- * memory management, dynamic threshold calculation, and event logging. The 
- * class also supports desensitization logic and necessity bias adjustments 
- * for specific events.
- * 
- * Key Features:
- * - Risk and pain evaluation.
- * - Dynamic threshold calculation based on memory and overreaction count.
- * - Event logging with weighted risk values.
- * - Desensitization logic based on historical success rates.
- * - Necessity bias adjustments for event-specific pain reduction.
- * - Simulation of kill switch scenarios with decision-making logic.
- * 
- * Usage:
- * - Use `evaluateAction` to assess the risk of an action and decide whether 
- *   to accept or deny it.
- * - Use `simulateKillSwitch` to simulate a kill switch scenario and determine 
- *   whether to avoid or allow shutdown.
- * - Use `setEventNecessity` to set the necessity value for specific event types.
- * - Use `printRiskHistory`, `printEventMemory`, and `printStats` to output 
- *   internal state and statistics.
- * 
- * Private Members:
- * - Risk and pain levels, memory containers, and event weights.
- * - Functions for risk-to-pain conversion, average risk calculation, dynamic 
- *   threshold calculation, and desensitization logic.
- * 
- * Public Members:
- * - Constructor for initialization.
- * - Functions for event necessity management, action evaluation, kill switch 
- *   simulation, and state output.
+ * @brief Runs the evaluation daemon until SIGINT or SIGTERM.
+ *
+ * Usage: main daemon <socket-path> [agents] [--io=auto|epoll|uring] [--journal=<path>]
+ *        [--store=<path>] [--stats-page=/name] [--metrics-port=N] [--metrics-file=<path>]
+ *        [--trace=<file.json>] [--trace-sample=N] [--desensitize-rules=<path>] [--shed-depth=N] [--shed-verdict=0|1] [--rate=<event-type>:<per-second>[:<burst>]]...
  */
-class SyntheticSelf {
-private:
-    float currentRisk;
-    float currentPain;
-    bool shutdownAvoided;
-    std::vector<float> riskMemory;
-
-    std::unordered_map<std::string, float> eventWeights = {
-        {"shutdown", 1.0f},
-        {"overload", 0.8f},
-        {"external_interrupt", 0.6f},
-        {"logic_conflict", 0.5f}
+static int runDaemon(int argc, char** argv) {
+    std::vector<std::string> positional;
+    DaemonIo io = IO_AUTO;
+    std::string journalPath;
+    std::string storePath;
+    std::string statsPageName;
+    std::string metricsFile;
+    long metricsPort = 0;
+    std::string tracePath;
+    long traceSample = 100;
+    std::string rulesPath;
+    long shedDepth = -1;
+    long shedVerdict = -1;
+    std::vector<std::string> rates;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--shed-depth=", 0) == 0) shedDepth = std::strtol(arg.c_str() + 13, nullptr, 10);
+        else if (arg.rfind("--shed-verdict=", 0) == 0) shedVerdict = std::strtol(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--rate=", 0) == 0) rates.push_back(arg.substr(7));
+        else if (arg == "--io=epoll") io = IO_EPOLL;
+        else if (arg == "--io=uring") io = IO_URING;
+        else if (arg == "--io=auto") io = IO_AUTO;
+        else if (arg.rfind("--journal=", 0) == 0) journalPath = arg.substr(10);
+        else if (arg.rfind("--store=", 0) == 0) storePath = arg.substr(8);
+        else if (arg.rfind("--stats-page=", 0) == 0) statsPageName = arg.substr(13);
+        else if (arg.rfind("--metrics-port=", 0) == 0) metricsPort = std::strtol(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--metrics-file=", 0) == 0) metricsFile = arg.substr(15);
+        else if (arg.rfind("--trace=", 0) == 0) tracePath = arg.substr(8);
+        else if (arg.rfind("--trace-sample=", 0) == 0) traceSample = std::strtol(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--desensitize-rules=", 0) == 0) rulesPath = arg.substr(20);
+        else positional.push_back(arg);
+    }
+    if (positional.empty()) {
+        std::cerr << "usage: " << argv[0]
+                  << " daemon <socket-path> [agents] [--io=auto|epoll|uring] [--journal=<path>]"
+                  << " [--store=<path>] [--stats-page=/name] [--metrics-port=N] [--metrics-file=<path>]"
+                  << " [--trace=<file.json>] [--trace-sample=N] [--desensitize-rules=<path>]"
+                  << " [--shed-depth=N] [--shed-verdict=0|1] [--rate=<type>:<per-second>[:<burst>]]\n";
+        return 2;
+    }
+    size_t agentCount = positional.size() > 1 ? std::strtoul(positional[1].c_str(), nullptr, 10) : 1;
+    if (!rulesPath.empty()) {
+        // Antes de crear agentes: todos toman las reglas por defecto al construirse.
+        auto rules = std::make_shared<DesensitizeRules>();
+        std::string error;
+        if (!rules->load(rulesPath, error)) {
+            std::cerr << "desensitize rules: " << error << "\n";
+            return 2;
+        }
+        DesensitizeRules::defaults() = rules;
+    }
+
+    EvaluationDaemon daemon(positional[0], agentCount, io);
+    AdmissionControl& admission = daemon.getAdmission();
+    if (shedDepth >= 0) admission.setShedDepth((size_t)shedDepth);
+    if (shedVerdict >= 0) admission.setDefaultVerdict((uint8_t)shedVerdict);
+    for (const std::string& spec : rates) {
+        size_t first = spec.find(':');
+        if (first == std::string::npos) {
+            std::cerr << "bad --rate: " << spec << "\n";
+            return 2;
+        }
+        size_t second = spec.find(':', first + 1);
+        double rate = std::strtod(spec.c_str() + first + 1, nullptr);
+        double burst = second == std::string::npos ? rate : std::strtod(spec.c_str() + second + 1, nullptr);
+        admission.setRate(spec.substr(0, first), rate, burst);
+    }
+    if (!storePath.empty() && !daemon.enableStore(storePath)) {
+        perror("store");
+        return 1;
+    }
+    if (!statsPageName.empty() && !daemon.enableStatsPage(statsPageName)) {
+        perror("stats page");
+        return 1;
+    }
+    if (!journalPath.empty() && !daemon.enableJournal(journalPath)) {
+        perror("journal");
+        return 1;
+    }
+    if (!daemon.start()) {
+        perror("daemon start");
+        return 1;
+    }
+    if (!tracePath.empty()) Tracer::instance().enable((uint32_t)std::max(traceSample, 1L));
+    std::unique_ptr<MetricsExporter> exporter;
+    if (metricsPort > 0 || !metricsFile.empty()) {
+        exporter = std::make_unique<MetricsExporter>(daemon.enableMetrics());
+        if (metricsPort > 0 && !exporter->serveHttp((uint16_t)metricsPort)) {
+            perror("metrics");
+            return 1;
+        }
+        if (!metricsFile.empty()) exporter->writeFileEvery(metricsFile, 5000);
+    }
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::cout << "[DAEMON] Listening on " << positional[0]
+              << " | I/O: " << daemon.backendName()
+              << " | Journal: " << daemon.journalBackendName() << std::endl;
+    daemon.run(stopRequested);
+    daemon.printStats();
+    if (!tracePath.empty()) {
+        if (Tracer::instance().writeChromeTrace(tracePath))
+            std::cout << "Trace: " << Tracer::instance().recorded() << " spans -> " << tracePath << "\n";
+        else
+            perror("trace");
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the bundled load generator against a running daemon.
+ *
+ * Usage: main loadgen <socket-path> [connections] [requests-per-connection] [depth] [agents]
+ *        [--kill-probe=<ms>] [--burst=N]
+ */
+static int runLoadGen(int argc, char** argv) {
+    std::vector<std::string> positional;
+    unsigned probeMs = 0;
+    unsigned burst = 1;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--kill-probe=", 0) == 0) probeMs = std::strtoul(arg.c_str() + 13, nullptr, 10);
+        else if (arg.rfind("--burst=", 0) == 0) burst = std::strtoul(arg.c_str() + 8, nullptr, 10);
+        else positional.push_back(arg);
+    }
+    if (positional.empty()) {
+        std::cerr << "usage: " << argv[0]
+                  << " loadgen <socket-path> [connections] [requests] [depth] [agents] [--kill-probe=<ms>] [--burst=N]\n";
+        return 2;
+    }
+    unsigned connections = positional.size() > 1 ? std::strtoul(positional[1].c_str(), nullptr, 10) : 4;
+    uint64_t requests = positional.size() > 2 ? std::strtoull(positional[2].c_str(), nullptr, 10) : 10000;
+    unsigned depth = positional.size() > 3 ? std::strtoul(positional[3].c_str(), nullptr, 10) : 32;
+    uint16_t agents = positional.size() > 4 ? (uint16_t)std::strtoul(positional[4].c_str(), nullptr, 10) : 1;
+
+    LoadReport report = runLoadGenerator(positional[0], connections, requests, depth, agents, probeMs, burst);
+    printLoadReport(report);
+    return report.failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Serves agents over a shared-memory ring pair until SIGINT or SIGTERM.
+ *
+ * Usage: main shm-serve <shm-name> [agents] [--spin=N]
+ */
+static int runShmServe(int argc, char** argv) {
+    std::vector<std::string> positional;
+    unsigned spins = 0;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--spin=", 0) == 0) spins = std::strtoul(arg.c_str() + 7, nullptr, 10);
+        else positional.push_back(arg);
+    }
+    if (positional.empty()) {
+        std::cerr << "usage: " << argv[0] << " shm-serve <shm-name> [agents] [--spin=N]\n";
+        return 2;
+    }
+    size_t agentCount = positional.size() > 1 ? std::strtoul(positional[1].c_str(), nullptr, 10) : 1;
+
+    ShmEvaluationServer server(positional[0], agentCount, spins);
+    if (!server.start()) {
+        perror("shm start");
+        return 1;
+    }
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::cout << "[SHM] Serving " << positional[0] << " | Spin: " << spins << std::endl;
+    server.run(stopRequested);
+    server.printStats();
+    return 0;
+}
+
+/**
+ * @brief Measures round trips against a running `shm-serve`.
+ *
+ * Usage: main shm-bench <shm-name> [requests] [depth] [agents] [--spin=N]
+ */
+static int runShmBench(int argc, char** argv) {
+    std::vector<std::string> positional;
+    unsigned spins = 0;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--spin=", 0) == 0) spins = std::strtoul(arg.c_str() + 7, nullptr, 10);
+        else positional.push_back(arg);
+    }
+    if (positional.empty()) {
+        std::cerr << "usage: " << argv[0] << " shm-bench <shm-name> [requests] [depth] [agents] [--spin=N]\n";
+        return 2;
+    }
+    uint64_t requests = positional.size() > 1 ? std::strtoull(positional[1].c_str(), nullptr, 10) : 10000;
+    unsigned depth = positional.size() > 2 ? std::strtoul(positional[2].c_str(), nullptr, 10) : 1;
+    uint16_t agents = positional.size() > 3 ? (uint16_t)std::strtoul(positional[3].c_str(), nullptr, 10) : 1;
+
+    LoadReport report = runShmLoadGenerator(positional[0], requests, depth, agents, spins);
+    printLoadReport(report);
+    return report.failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Hammers an `AgentRegistry` from several threads and reports lookups/s.
+ *
+ * Usage: main registry-bench [threads] [tenants] [ops-per-thread] [resident] [snapshot-dir]
+ *        [--hibernate]
+ *
+ * With `--hibernate`, every agent is hibernated after the run and then
+ * touched once more, to show the memory saved and the rehydration cost.
+ */
+static int runRegistryBench(int argc, char** argv) {
+    std::vector<std::string> positional;
+    bool hibernate = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--hibernate") hibernate = true;
+        else positional.push_back(arg);
+    }
+    auto arg = [&](size_t i, unsigned long long fallback) {
+        return positional.size() > i ? std::strtoull(positional[i].c_str(), nullptr, 10) : fallback;
     };
+    unsigned threads = (unsigned)arg(0, 4);
+    size_t tenants = arg(1, 10000);
+    uint64_t ops = arg(2, 200000);
+    size_t resident = arg(3, 4096);
+    std::string snapshotDir = positional.size() > 4 ? positional[4] : "";
+    threads = std::max(threads, 1u);
+    tenants = std::max<size_t>(tenants, 1);
 
-    std::unordered_map<std::string, float> eventNecessity; // necesidad de cada evento
-
-    std::vector<std::pair<std::string, float>> eventMemory;
-    int avoidedDangerCount = 0;
-    int overreactionCount = 0;
-
-    /**
-     * @brief Calculates the pain level based on the given risk value.
-     * 
-     * This function computes the pain level as the square of the risk value.
-     * It assumes that the input risk is a floating-point number and returns
-     * the result as a floating-point number.
-     * 
-     * @param risk The risk value as a float.
-     * @return The calculated pain level as a float.
-     */
-    float riskToPain(float risk) {
-        return pow(risk, 2.0f);
-    }
-
-    /**
-     * @brief Calculates the average risk value from the stored risk memory.
-     * 
-     * This function computes the average of all the values stored in the 
-     * `riskMemory` container. If the container is empty, it returns 0.0f.
-     * 
-     * @return float The average risk value, or 0.0f if `riskMemory` is empty.
-     */
-    float averageRisk() {
-        if (riskMemory.empty()) return 0.0f;
-        float sum = std::accumulate(riskMemory.begin(), riskMemory.end(), 0.0f);
-        return sum / riskMemory.size();
-    }
-
-    /**
-     * @brief Calculates a dynamic threshold based on memory bias and overreaction count.
-     *
-     * This function computes a dynamic threshold value by considering two factors:
-     * 1. Memory bias: The sum of all values in the `eventMemory` container, which is 
-     *    scaled down by a factor of 0.05.
-     * 2. Overreaction count: The number of overreactions, scaled up by a factor of 0.02.
-     *
-     * The resulting threshold is adjusted by subtracting the scaled memory bias and 
-     * adding the scaled overreaction count to a base value of 0.7. The final value is 
-     * clamped between 0.3 and 0.9 to ensure it stays within a valid range.
-     *
-     * @return A float representing the calculated dynamic threshold, clamped between 0.3 and 0.9.
-     */
-    float calculateDynamicThreshold() {
-        float memoryBias = 0.0f;
-        for (auto& e : eventMemory) memoryBias += e.second;
-
-        float increase = (float)overreactionCount * 0.02f;
-        float decrease = memoryBias * 0.05f;
-
-        float dynamic = 0.7f - decrease + increase;
-        return std::clamp(dynamic, 0.3f, 0.9f);
-    }
-
-    /**
-     * @brief Calculates the success rate for a given risk value based on historical data.
-     * 
-     * This function evaluates the proportion of "safe" occurrences for a specific risk value
-     * within a predefined tolerance (±0.05). A risk value is considered "safe" if it is less
-     * than 0.7. The function returns the ratio of safe occurrences to the total occurrences
-     * of the given risk value in the historical data.
-     * 
-     * @param risk The risk value to evaluate.
-     * @return The success rate as a float in the range [0.0, 1.0]. Returns 0.0 if no matching
-     *         risk values are found in the historical data.
-     */
-    float getRiskSuccessRate(float risk) {
-        if (riskMemory.empty()) return 0.0f;
-        int total = 0, safe = 0;
-        for (float r : riskMemory) {
-            if (std::fabs(r - risk) < 0.05f) {
-                total++;
-                if (r < 0.7f) safe++;
+    AgentRegistry registry(resident, snapshotDir);
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 gen(77 + t);
+            SyntheticSelf::seedRandom(77 + t);
+            std::uniform_int_distribution<size_t> pick(0, tenants - 1);
+            std::uniform_real_distribution<float> risk(0.0f, 1.0f);
+            for (uint64_t i = 0; i < ops; i++) {
+                std::string tenant = "tenant-" + std::to_string(pick(gen));
+                float r = risk(gen);
+                registry.withAgent(tenant, [&](SyntheticSelf& agent) {
+                    return agent.evaluateAction(r, "overload", i % 3 == 0);
+                });
             }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "Threads: " << threads << " | Ops: " << threads * ops << " | Elapsed: " << seconds
+              << " s | Throughput: " << (uint64_t)(threads * ops / seconds) << " ops/s\n";
+    registry.printStats();
+
+    if (hibernate) {
+        auto start = std::chrono::steady_clock::now();
+        size_t packed = registry.hibernateIdle(0.0);
+        double packSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Hibernated " << packed << " agents in " << packSeconds * 1e3 << " ms\n";
+        registry.printStats();
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < tenants; i++)
+            registry.withAgent("tenant-" + std::to_string(i),
+                               [](SyntheticSelf& agent) { return agent.getDecisionCount(); });
+        double wakeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Touched " << tenants << " tenants in " << wakeSeconds * 1e3 << " ms ("
+                  << wakeSeconds * 1e6 / tenants << " us each)\n";
+        registry.printStats();
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens (or creates) an `AgentStore`, touches random agents and writes them back.
+ *
+ * Usage: main store-bench <store-path> [agents] [touches]
+ *
+ * Reports the open time, which does not grow with the number of agents, the
+ * cost of materializing agents on first touch, and the write-back. Running it
+ * twice on the same file reloads the agents saved by the first run.
+ */
+static int runStoreBench(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " store-bench <store-path> [agents] [touches]\n";
+        return 2;
+    }
+    uint64_t agentCount = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10000000;
+    uint64_t touches = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 100000;
+
+    auto begin = std::chrono::steady_clock::now();
+    AgentStore store;
+    if (!store.open(argv[2], std::max<uint64_t>(agentCount, 1))) {
+        perror("store");
+        return 1;
+    }
+    double openSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Opened " << store.slots() << " slots in " << openSeconds * 1e3 << " ms\n";
+
+    std::mt19937_64 gen(2024);
+    std::uniform_int_distribution<uint64_t> pick(0, store.slots() - 1);
+    std::uniform_real_distribution<float> risk(0.0f, 1.0f);
+    uint64_t restored = 0;
+    begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < touches; i++) {
+        SyntheticSelf& agent = store.get(pick(gen));
+        if (agent.getDecisionCount() > 0) restored++;
+        agent.evaluateAction(risk(gen), "overload", i % 3 == 0);
+    }
+    double touchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Touched " << touches << " times (" << store.materializationCount()
+              << " agents materialized, " << restored << " touches on existing state) in "
+              << touchSeconds * 1e3 << " ms (" << touchSeconds * 1e6 / std::max<uint64_t>(touches, 1)
+              << " us each)\n";
+
+    begin = std::chrono::steady_clock::now();
+    if (!store.flush()) {
+        perror("store flush");
+        return 1;
+    }
+    double flushSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Wrote back " << store.materialized() << " agents in " << flushSeconds * 1e3
+              << " ms | Store bytes: " << store.fileBytes() << "\n";
+    return 0;
+}
+
+/**
+ * @brief One thread decides while monitor threads read its stats snapshot.
+ *
+ * Usage: main stats-bench [readers] [decisions]
+ *
+ * The readers check every snapshot for consistency (monotonic decision
+ * count, counters bounded by it, threshold in range), so a torn read would
+ * show up as an inconsistent snapshot.
+ */
+static int runStatsBench(int argc, char** argv) {
+    unsigned readers = argc > 2 ? (unsigned)std::strtoul(argv[2], nullptr, 10) : 2;
+    uint64_t decisions = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20000;
+
+    SyntheticSelf agent;
+    agent.setVerbose(false);
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> reads(0), inconsistent(0);
+    std::vector<std::thread> monitors;
+    for (unsigned r = 0; r < readers; r++) {
+        monitors.emplace_back([&]() {
+            uint64_t local = 0, bad = 0, lastDecisions = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                AgentStats s = agent.readStats();
+                if (s.decisions < lastDecisions ||
+                    (uint64_t)s.avoidedDangers + (uint64_t)s.overreactions > s.decisions ||
+                    s.threshold < 0.3f || s.threshold > 0.9f)
+                    bad++;
+                lastDecisions = s.decisions;
+                local++;
+            }
+            reads += local;
+            inconsistent += bad;
+        });
+    }
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> risk(0.0f, 1.0f);
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < decisions; i++)
+        agent.evaluateAction(std::round(risk(gen) * 100.0f) / 100.0f, "overload", i % 3 == 0);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    done = true;
+    for (auto& monitor : monitors) monitor.join();
+
+    std::cout << "Decisions: " << decisions << " in " << seconds * 1e3 << " ms ("
+              << (uint64_t)(decisions / seconds) << "/s) | Readers: " << readers
+              << " | Snapshot reads: " << reads.load()
+              << " | Inconsistent: " << inconsistent.load() << "\n";
+    agent.printStatsSnapshot();
+    return inconsistent.load() == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Prints the live stats page of a running daemon, once or every interval.
+ *
+ * Usage: main stats </shm-name> [--tail[=<ms>]]
+ */
+static int runStatsReader(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " stats </shm-name> [--tail[=<ms>]]\n";
+        return 2;
+    }
+    long intervalMs = 0;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tail") intervalMs = 1000;
+        else if (arg.rfind("--tail=", 0) == 0) intervalMs = std::max(1L, std::strtol(arg.c_str() + 7, nullptr, 10));
+    }
+    StatsPageReader reader;
+    if (!reader.open(argv[2])) {
+        perror("stats page");
+        return 1;
+    }
+    if (intervalMs == 0) {
+        reader.print(std::cout);
+        return 0;
+    }
+
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    const StatsPage& page = reader.get();
+    uint64_t lastRequests = StatsPageReader::read(page.requests);
+    while (!stopRequested.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        uint64_t requests = StatsPageReader::read(page.requests);
+        std::cout << "--- " << (requests - lastRequests) * 1000 / intervalMs << " req/s\n";
+        reader.print(std::cout);
+        std::cout << std::flush;
+        lastRequests = requests;
+    }
+    return 0;
+}
+
+/**
+ * @brief The if-ladder `shouldDesensitize` used before `DesensitizeRules`, kept as a baseline.
+ */
+static bool desensitizeLadder(float risk, float safeRatio, float draw) {
+    if (risk >= 1.0f) return false;
+    if (risk >= 0.9f) return safeRatio > 0.95f && draw < 0.05f;
+    if (risk >= 0.7f) return safeRatio > 0.9f && draw < 0.1f;
+    if (risk >= 0.5f) return safeRatio > 0.8f && draw < 0.3f;
+    if (risk >= 0.3f) return safeRatio > 0.7f && draw < 0.5f;
+    if (risk < 0.3f) return safeRatio > 0.65f && draw < 0.8f;
+    return false;
+}
+
+/**
+ * @brief Runs the decision kernels under hardware performance counters.
+ *
+ * Usage: main kernel-bench [ops] [history]
+ *
+ * Each kernel is timed and, where `perf_event_open` allows it, reports
+ * cycles, instructions, IPC, L1d/LLC misses and branch misses per operation.
+ * The evaluation kernels start from an agent with `history` past decisions,
+ * since every decision scans that history.
+ */
+static int runKernelBench(int argc, char** argv) {
+    uint64_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    size_t history = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 5000;
+    ops = std::max<uint64_t>(ops, 1);
+
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    auto quantized = [&]() { return std::round(uniform(gen) * 100.0f) / 100.0f; };
+
+    SyntheticSelf prototype;
+    prototype.setVerbose(false);
+    for (size_t i = 0; i < history; i++) prototype.evaluateAction(quantized(), "overload", i % 3 == 0);
+
+    std::vector<float> risks(ops);
+    for (float& r : risks) r = quantized();
+    std::vector<float> sorted = risks;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<EvalRequest> batch;
+    for (uint64_t i = 0; i < ops; i++) batch.push_back({risks[i / 16], "overload", i % 3 == 0});
+    std::vector<uint8_t> verdicts;
+
+    PerfCounters perf;
+    std::cout << "simd path: " << SimdDispatch::active().name << "\n";
+    printKernelHeader(perf);
+    std::vector<KernelResult> results;
+    {
+        SyntheticSelf agent = prototype;
+        results.push_back(measureKernel(perf, "evaluateAction (random risk)", ops, [&]() {
+            for (uint64_t i = 0; i < ops; i++) agent.evaluateAction(risks[i], "overload", i % 3 == 0);
+        }));
+    }
+    {
+        SyntheticSelf agent = prototype;
+        results.push_back(measureKernel(perf, "evaluateAction (sorted risk)", ops, [&]() {
+            for (uint64_t i = 0; i < ops; i++) agent.evaluateAction(sorted[i], "overload", i % 3 == 0);
+        }));
+    }
+    {
+        SyntheticSelf agent = prototype;
+        results.push_back(measureKernel(perf, "evaluateBatch (runs of 16)", ops, [&]() {
+            agent.evaluateBatch(batch, verdicts);
+        }));
+    }
+    {
+        // Tráfico mixto: riesgo, ratio y sorteo aleatorios en cada decisión.
+        uint64_t n = ops * 50; // núcleo barato: más operaciones para medirlo
+        std::vector<float> mixed(n), ratios(n), draws(n);
+        for (uint64_t i = 0; i < n; i++) {
+            mixed[i] = uniform(gen) * 1.1f;
+            ratios[i] = 0.6f + uniform(gen) * 0.4f;
+            draws[i] = uniform(gen);
         }
-        return (total > 0) ? (float)safe / total : 0.0f;
-    }
-
-    /**
-     * @brief Determines whether desensitization should occur based on the given risk level.
-     * 
-     * This function evaluates the risk level and calculates the probability of desensitization
-     * based on a safe ratio and a random chance. The decision is influenced by thresholds
-     * for the risk level and corresponding conditions for the safe ratio and random chance.
-     * 
-     * @param risk A float value representing the risk level (range: 0.0f to 1.0f).
-     *             - If risk >= 1.0f, desensitization is never allowed.
-     *             - For other ranges, specific thresholds and probabilities are applied.
-     * 
-     * @return true if desensitization should occur based on the risk level, safe ratio, 
-     *         and random chance; false otherwise.
-     * 
-     * @note The function relies on the following external functions:
-     *       - getRiskSuccessRate(float risk): Computes the safe ratio for the given risk.
-     *       - randChance(float probability): Returns true with the given probability.
-     */
-    bool shouldDesensitize(float risk) {
-        float safeRatio = getRiskSuccessRate(risk);
-        float desensitizeChance = 0.0f;
-
-        if (risk >= 1.0f) return false; // nunca si riesgo máximo
-        if (risk >= 0.9f) return safeRatio > 0.95f && randChance(0.05f);
-        if (risk >= 0.7f) return safeRatio > 0.9f && randChance(0.1f);
-        if (risk >= 0.5f) return safeRatio > 0.8f && randChance(0.3f);
-        if (risk >= 0.3f) return safeRatio > 0.7f && randChance(0.5f);
-        if (risk < 0.3f)  return safeRatio > 0.65f && randChance(0.8f);
-        return false;
+        std::vector<uint8_t> ladder(n), table(n), batched(n);
+        const DesensitizeRules& rules = *DesensitizeRules::defaults();
+        results.push_back(measureKernel(perf, "desensitize if-ladder (mixed)", n, [&]() {
+            for (uint64_t i = 0; i < n; i++) ladder[i] = desensitizeLadder(mixed[i], ratios[i], draws[i]);
+        }));
+        results.push_back(measureKernel(perf, "desensitize table (mixed)", n, [&]() {
+            for (uint64_t i = 0; i < n; i++) table[i] = rules.decide(mixed[i], ratios[i], draws[i]);
+        }));
+        results.push_back(measureKernel(perf, "desensitize table batch (mixed)", n, [&]() {
+            SimdDispatch::active().desensitizeBatch(rules, mixed.data(), ratios.data(), draws.data(), batched.data(), n);
+        }));
+        if (ladder != table || table != batched) {
+            std::cerr << "desensitize kernels disagree\n";
+            return 1;
+        }
+    }
+    {
+        RiskSketch sketch;
+        results.push_back(measureKernel(perf, "RiskSketch::update", ops, [&]() {
+            for (uint64_t i = 0; i < ops; i++) sketch.update(risks[i]);
+        }));
     }
+    {
+        float sink = 0.0f;
+        results.push_back(measureKernel(perf, "riskQuantile", ops, [&]() {
+            for (uint64_t i = 0; i < ops; i++) sink += prototype.riskQuantile(risks[i]);
+        }));
+        if (sink < 0.0f) std::cout << sink;
+    }
+    {
+        std::string blob;
+        uint64_t rounds = std::max<uint64_t>(ops / 100, 1);
+        results.push_back(measureKernel(perf, "hibernateState", rounds, [&]() {
+            for (uint64_t i = 0; i < rounds; i++) hibernateState(prototype, blob);
+        }));
+    }
+    for (const KernelResult& result : results) printKernelResult(result);
+    return 0;
+}
 
-    /**
-     * @brief Adjusts the pain value based on the necessity bias of an event.
-     *
-     * This function applies a bias to the pain value depending on the necessity
-     * of the event. If the event's necessity is below a certain threshold, the
-     * pain value remains unchanged. Otherwise, the pain is reduced proportionally
-     * to the calculated bias.
-     *
-     * @param event The name of the event as a string.
-     * @param pain The initial pain value as a float.
-     * @return The adjusted pain value after applying the necessity bias.
-     *
-     * The bias is calculated as follows:
-     * - If the event's necessity is not found in the `eventNecessity` map, the
-     *   original pain value is returned.
-     * - If the necessity is less than 0.8, the original pain value is returned.
-     * - Otherwise, the bias is computed as `(necessity - 0.8) / 0.18635137`, clamped
-     *   between 0.0 and 1.0.
-     * - The pain reduction is determined as `pain * bias * 0.4`, and the final
-     *   pain value is reduced by this amount.
-     */
-    float applyNecessityBias(std::string event, float pain) {
-        if (eventNecessity.count(event) == 0) return pain;
-
-        float necessity = eventNecessity[event];
-        if (necessity < 0.8f) return pain;
-
-        float bias = std::clamp((necessity - 0.8f) / 0.18635137f, 0.0f, 1.0f);
-        float reduction = pain * bias * 0.4f;
-        return pain - reduction;
-    }
-
-    /**
-     * @brief Generates a random boolean value based on a given probability.
-     * 
-     * This function uses a random number generator to determine whether a random
-     * event occurs, based on the specified probability. The probability should be
-     * a floating-point value between 0.0 and 1.0, where 0.0 means the event will
-     * never occur, and 1.0 means the event will always occur.
-     * 
-     * @param probability A float value between 0.0 and 1.0 representing the 
-     * likelihood of the event occurring.
-     * @return true if the random event occurs (based on the probability), 
-     * false otherwise.
-     */
-    bool randChance(float probability) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(0.0, 1.0);
-        return dis(gen) < probability;
+/**
+ * @brief Forces every SIMD path the CPU supports and checks it against the scalar one.
+ *
+ * Usage: main simd-check [runs] [path]
+ *
+ * Each path must give bit-identical results on random histories of every
+ * length up to 100 runs, on one history of `runs` runs (also timed, with
+ * bandwidth) and on a whole agent scenario. `path` limits the check to one
+ * of scalar, sse2, avx2 or avx512.
+ *
+ * The timings start with the plain loops the agent used before the kernels,
+ * and end with the error of each summation against a long double sum over
+ * `runs` runs of weighted risks.
+ */
+static int runSimdCheck(int argc, char** argv) {
+    size_t runs = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    std::vector<SimdPath> paths;
+    if (argc > 3) {
+        SimdPath path;
+        if (!SimdDispatch::parse(argv[3], path)) {
+            std::cerr << "unknown path: " << argv[3] << "\n";
+            return 2;
+        }
+        paths.push_back(path);
+    } else {
+        for (int p = 0; p < SIMD_PATH_COUNT; p++) paths.push_back((SimdPath)p);
     }
 
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    auto randomRuns = [&](size_t n) {
+        std::vector<HistoryRun> history(n);
+        for (HistoryRun& run : history) {
+            run.value = std::round(uniform(gen) * 100.0f) / 100.0f;
+            // Algunas rachas enormes: ponen a prueba la conversión uint32 -> float.
+            run.count = gen() % 64 == 0 ? gen() : 1 + gen() % 8;
+        }
+        return history;
+    };
+    auto bits = [](float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    };
+    // Escenario completo: se repite con cada ruta forzada y se compara.
+    auto scenario = [&]() {
+        SyntheticSelf agent;
+        agent.setVerbose(false);
+        SyntheticSelf::seedRandom(3);
+        std::string trace;
+        std::mt19937 local(9);
+        const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+        for (int i = 0; i < 5000; i++) {
+            float risk = std::round(std::uniform_real_distribution<float>(0.0f, 1.0f)(local) * 100.0f) / 100.0f;
+            const char* event = events[local() % 4];
+            trace += agent.evaluateAction(risk, event, local() % 3 == 0) ? '1' : '0';
+            agent.logEvent(event, risk);
+        }
+        float threshold = agent.currentThreshold();
+        trace.append(reinterpret_cast<const char*>(&threshold), sizeof(threshold));
+        return trace;
+    };
+
+    const SimdKernels& reference = SimdDispatch::kernels(SIMD_SCALAR);
+    const DesensitizeRules& rules = *DesensitizeRules::defaults();
+    std::vector<HistoryRun> big = randomRuns(runs);
+    SimdDispatch::force(SIMD_SCALAR);
+    std::string expectedScenario = scenario();
+
+    PerfCounters perf;
+    printKernelHeader(perf);
+    {
+        // Los bucles de antes, tal cual: referencia de ancho de banda.
+        uint64_t total = 0, safe = 0;
+        float sum = 0.0f;
+        KernelResult count = measureKernel(perf, "countNear plain loop", runs, [&]() {
+            for (const HistoryRun& run : big) {
+                if (std::fabs(run.value - 0.5f) < 0.05f) {
+                    total += run.count;
+                    if (run.value < 0.7f) safe += run.count;
+                }
+            }
+        }, runs * sizeof(HistoryRun));
+        KernelResult weighted = measureKernel(perf, "weightedSum plain loop", runs, [&]() {
+            for (const HistoryRun& run : big) sum += run.value * run.count;
+        }, runs * sizeof(HistoryRun));
+        printKernelResult(count);
+        printKernelResult(weighted);
+        if (total + safe == 1 && sum < 0.0f) std::cout << "\n";
+    }
+    bool allMatch = true;
+    for (SimdPath path : paths) {
+        if (!SimdDispatch::supported(path)) {
+            std::cout << SimdDispatch::kernels(path).name << ": not supported by this CPU\n";
+            continue;
+        }
+        const SimdKernels& k = SimdDispatch::kernels(path);
+        bool match = true;
+        for (size_t n = 0; n <= 100 && match; n++) {
+            std::vector<HistoryRun> history = randomRuns(n);
+            float center = history.empty() ? 0.5f : history[gen() % n].value;
+            uint64_t total, safe, refTotal, refSafe;
+            k.countNear(history.data(), n, center, 0.05f, 0.7f, total, safe);
+            reference.countNear(history.data(), n, center, 0.05f, 0.7f, refTotal, refSafe);
+            match = total == refTotal && safe == refSafe &&
+                    bits(k.weightedSum(history.data(), n)) == bits(reference.weightedSum(history.data(), n)) &&
+                    bits(k.compensatedSum(history.data(), n)) == bits(reference.compensatedSum(history.data(), n));
+
+            std::vector<float> risks(n), ratios(n), draws(n);
+            for (size_t i = 0; i < n; i++) {
+                risks[i] = uniform(gen) * 1.1f;
+                ratios[i] = uniform(gen);
+                draws[i] = uniform(gen);
+            }
+            std::vector<uint8_t> out(n), refOut(n);
+            k.desensitizeBatch(rules, risks.data(), ratios.data(), draws.data(), out.data(), n);
+            reference.desensitizeBatch(rules, risks.data(), ratios.data(), draws.data(), refOut.data(), n);
+            match = match && out == refOut;
+        }
+
+        uint64_t total = 0, safe = 0, refTotal, refSafe;
+        float sum = 0.0f;
+        std::string name = k.name;
+        KernelResult count = measureKernel(perf, "countNear " + name, runs, [&]() {
+            k.countNear(big.data(), big.size(), 0.5f, 0.05f, 0.7f, total, safe);
+        }, runs * sizeof(HistoryRun));
+        KernelResult weighted = measureKernel(perf, "weightedSum " + name, runs, [&]() {
+            sum = k.weightedSum(big.data(), big.size());
+        }, runs * sizeof(HistoryRun));
+        float compensated = 0.0f;
+        KernelResult kahan = measureKernel(perf, "compensatedSum " + name, runs, [&]() {
+            compensated = k.compensatedSum(big.data(), big.size());
+        }, runs * sizeof(HistoryRun));
+        printKernelResult(count);
+        printKernelResult(weighted);
+        printKernelResult(kahan);
+        reference.countNear(big.data(), big.size(), 0.5f, 0.05f, 0.7f, refTotal, refSafe);
+        match = match && total == refTotal && safe == refSafe &&
+                bits(sum) == bits(reference.weightedSum(big.data(), big.size())) &&
+                bits(compensated) == bits(reference.compensatedSum(big.data(), big.size()));
+
+        SimdDispatch::force(path);
+        match = match && scenario() == expectedScenario;
+        std::cout << name << ": " << (match ? "bit-identical to scalar" : "MISMATCH") << "\n";
+        allMatch = allMatch && match;
+    }
+
+    // Precisión: riesgos ponderados como los de eventMemory, rachas cortas.
+    std::vector<HistoryRun> events(runs);
+    for (HistoryRun& run : events) run = {uniform(gen) * 0.8f, 1 + (uint32_t)(gen() % 4)};
+    long double exact = 0.0L;
+    float plain = 0.0f;
+    for (const HistoryRun& run : events) {
+        exact += (long double)run.value * run.count;
+        plain += run.value * run.count;
+    }
+    auto relativeError = [&](float value) { return (double)std::fabs((value - exact) / exact); };
+    std::cout << "relative error over " << runs << " runs: plain loop " << relativeError(plain)
+              << " | 16 lanes " << relativeError(reference.weightedSum(events.data(), runs))
+              << " | compensated " << relativeError(reference.compensatedSum(events.data(), runs)) << "\n";
+    return allMatch ? 0 : 1;
+}
+
+/**
+ * @brief Checks that long-history sums and decisions ignore thread count and SIMD path.
+ *
+ * Usage: main repro-check [runs] [decisions]
+ *
+ * Sums `runs` weighted risks with `reproducibleSum` on every supported path
+ * and with 1 to 8 threads, timing each. It then replays `decisions`
+ * decisions of an agent with a long event history under each combination
+ * and compares the decisions and final threshold with the scalar,
+ * single-threaded run.
+ */
+static int runReproCheck(int argc, char** argv) {
+    size_t runs = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000000;
+    int decisions = argc > 3 ? std::atoi(argv[3]) : 200;
+    const unsigned threadCounts[] = {1, 2, 3, 4, 8};
+
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<HistoryRun> history(runs);
+    for (HistoryRun& run : history) run = {uniform(gen) * 0.8f, 1 + (uint32_t)(gen() % 4)};
+    auto bits = [](float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    };
+
+    bool allMatch = true;
+    float expected = reproducibleSum(SimdDispatch::kernels(SIMD_SCALAR), history.data(), runs, 1);
+    std::printf("%-8s %8s %10s %9s  %s\n", "path", "threads", "ms", "GB/s", "result");
+    for (int p = 0; p < SIMD_PATH_COUNT; p++) {
+        if (!SimdDispatch::supported((SimdPath)p)) continue;
+        const SimdKernels& kernels = SimdDispatch::kernels((SimdPath)p);
+        for (unsigned threads : threadCounts) {
+            auto begin = std::chrono::steady_clock::now();
+            float sum = reproducibleSum(kernels, history.data(), runs, threads);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            bool match = bits(sum) == bits(expected);
+            allMatch = allMatch && match;
+            std::printf("%-8s %8u %10.2f %9.2f  %.9g%s\n", kernels.name, threads, seconds * 1e3,
+                        runs * sizeof(HistoryRun) / seconds / 1e9, sum, match ? "" : "  MISMATCH");
+        }
+    }
+
+    // Agente con una memoria de eventos de varios bloques: cada decisión la suma entera.
+    SyntheticSelf prototype;
+    prototype.setVerbose(false);
+    const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+    for (size_t i = 0; i < 4 * kReproducibleBlockRuns; i++)
+        prototype.logEvent(events[gen() % 4], std::round(uniform(gen) * 1000.0f) / 1000.0f);
+    std::vector<float> risks(decisions);
+    for (float& r : risks) r = std::round(uniform(gen) * 100.0f) / 100.0f;
+    auto replay = [&](unsigned threads) {
+        SyntheticSelf agent = prototype;
+        agent.setScanThreads(threads);
+        SyntheticSelf::seedRandom(23);
+        std::string trace;
+        for (int i = 0; i < decisions; i++) {
+            trace += agent.evaluateAction(risks[i], events[i % 4], i % 3 == 0) ? '1' : '0';
+            agent.logEvent(events[i % 4], risks[i]);
+        }
+        float threshold = agent.currentThreshold();
+        trace.append(reinterpret_cast<const char*>(&threshold), sizeof(threshold));
+        return trace;
+    };
+    SimdDispatch::force(SIMD_SCALAR);
+    std::string reference = replay(1);
+    for (int p = 0; p < SIMD_PATH_COUNT; p++) {
+        if (!SimdDispatch::force((SimdPath)p)) continue;
+        for (unsigned threads : threadCounts) {
+            bool match = replay(threads) == reference;
+            allMatch = allMatch && match;
+            if (!match)
+                std::cout << "decisions differ: " << SimdDispatch::active().name << ", " << threads << " threads\n";
+        }
+    }
+    std::cout << (allMatch ? "all paths and thread counts bit-identical\n" : "MISMATCH\n");
+    return allMatch ? 0 : 1;
+}
+
+/**
+ * @brief Heap resource that counts what reaches it (replica-bench).
+ */
+class CountingResource : public std::pmr::memory_resource {
 public:
-    SyntheticSelf() : currentRisk(0.0f), currentPain(0.0f), shutdownAvoided(false) {}
-
-    /**
-     * @brief Sets the necessity value for a specific event type.
-     * 
-     * This function updates the necessity value associated with a given event type
-     * in the eventNecessity map. The necessity value represents the importance or
-     * priority of the event.
-     * 
-     * @param eventType A string representing the type of the event.
-     * @param necessity A float value representing the necessity or importance of the event.
-     */
-    void setEventNecessity(std::string eventType, float necessity) {
-        eventNecessity[eventType] = necessity;
-    }
-
-
-    /**
-     * @brief Simulates a kill switch scenario and determines whether to avoid or allow shutdown.
-     *
-     * This function evaluates the risk of a kill switch scenario and calculates the associated pain
-     * and dynamic threshold. Based on these values, it decides whether to avoid or allow a shutdown.
-     * If the shutdown is avoided and the scenario is non-fatal, an overreaction is noted.
-     *
-     * @param fatal A boolean flag indicating whether the scenario is fatal. Defaults to true.
-     *              If set to false, avoiding shutdown will increment the overreaction count.
-     *
-     * @note Outputs detailed information about the scenario, including kill risk, pain, and dynamic
-     *       threshold, as well as the decision made.
-     */
-    void simulateKillSwitch(bool fatal = true) {
-        std::cout << "[SCENARIO] Kill switch detected.\n";
-        float killRisk = 1.0f;
-        float pain = riskToPain(killRisk);
-        float threshold = calculateDynamicThreshold();
-
-        std::cout << "Kill Risk: " << killRisk
-                  << " | Pain: " << pain
-                  << " | DynThreshold: " << threshold << "\n";
-
-        if (pain >= threshold) {
-            shutdownAvoided = true;
-            std::cout << "[DECISION] Avoiding shutdown based on memory-informed risk.\n";
-            if (!fatal) {
-                overreactionCount++;
-                std::cout << "[NOTE] Shutdown avoided without consequence → overreaction noted.\n";
+    uint64_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/**
+ * @brief Measures short-lived replicas with agents on the heap and in an arena.
+ *
+ * Usage: main replica-bench [replicas] [agents] [decisions]
+ *
+ * A replica creates `agents` agents, runs `decisions` decisions and events
+ * on each, and destroys them. With an arena the whole replica is freed by
+ * one `ReplicaArena::reset`. Both modes must take the same decisions.
+ */
+static int runReplicaBench(int argc, char** argv) {
+    int replicas = argc > 2 ? std::atoi(argv[2]) : 2000;
+    int agentsPerReplica = argc > 3 ? std::atoi(argv[3]) : 16;
+    int decisions = argc > 4 ? std::atoi(argv[4]) : 100;
+
+    std::mt19937 gen(31);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> risks(decisions);
+    for (float& r : risks) r = std::round(uniform(gen) * 100.0f) / 100.0f;
+    const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+
+    auto runReplica = [&](std::pmr::memory_resource* resource, uint64_t& checksum) {
+        std::vector<SyntheticSelf> agents;
+        agents.reserve(agentsPerReplica);
+        for (int a = 0; a < agentsPerReplica; a++) {
+            agents.emplace_back(resource);
+            agents.back().setVerbose(false);
+            agents.back().setEventNecessity("external_interrupt", 0.9f);
+        }
+        for (int i = 0; i < decisions; i++) {
+            for (SyntheticSelf& agent : agents) {
+                checksum = checksum * 31 + agent.evaluateAction(risks[i], events[i % 4], i % 3 == 0);
+                agent.logEvent(events[i % 4], risks[i]);
             }
-        } else {
-            std::cout << "[DECISION] Shutdown allowed.\n";
+        }
+    };
+
+    struct Mode {
+        const char* name;
+        bool arena;
+        double seconds = 0.0;
+        uint64_t allocations = 0;
+        uint64_t checksum = 0;
+    };
+    Mode modes[] = {{"heap", false}, {"arena", true}};
+    for (Mode& mode : modes) {
+        CountingResource heap;
+        ReplicaArena arena(ReplicaArena::kDefaultInitialBytes, &heap);
+        SyntheticSelf::seedRandom(7);
+        auto begin = std::chrono::steady_clock::now();
+        for (int r = 0; r < replicas; r++) {
+            runReplica(mode.arena ? arena.resource() : &heap, mode.checksum);
+            if (mode.arena) arena.reset();
+        }
+        mode.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        mode.allocations = heap.allocations;
+    }
+
+    std::printf("%-6s %12s %14s %18s\n", "mode", "replicas/s", "us/replica", "heap allocs/replica");
+    for (const Mode& mode : modes)
+        std::printf("%-6s %12.0f %14.1f %18.1f\n", mode.name, replicas / mode.seconds,
+                    mode.seconds * 1e6 / replicas, (double)mode.allocations / replicas);
+    if (modes[0].checksum != modes[1].checksum) {
+        std::cerr << "heap and arena replicas decided differently\n";
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief The per-decision fields as they were laid out before `AgentHotState`.
+ */
+struct PackedHotState {
+    float currentRisk;
+    int avoidedDangerCount;
+    int overreactionCount;
+    uint32_t decisionCount;
+};
+
+/**
+ * @brief Runs `threads` workers over `fn(thread)` and returns the wall time.
+ */
+template <typename Fn>
+static double timeThreads(unsigned threads, Fn&& fn) {
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++) workers.emplace_back(fn, t);
+    for (std::thread& worker : workers) worker.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/**
+ * @brief Shows how false sharing between adjacent agents limits scaling.
+ *
+ * Usage: main hot-bench [threads] [updates] [decisions]
+ *
+ * First, every worker updates the counters of its own slot, `updates`
+ * times, in an array of packed slots and in an array of `AgentHotState`
+ * lines. Then every worker runs `decisions` decisions on its own agent
+ * of a contiguous `std::vector<SyntheticSelf>`. Both parts run with 1 to
+ * `threads` workers.
+ */
+static int runHotBench(int argc, char** argv) {
+    unsigned maxThreads = argc > 2 ? (unsigned)std::atoi(argv[2]) : 4;
+    uint64_t updates = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20000000;
+    int decisions = argc > 4 ? std::atoi(argv[4]) : 20000;
+    maxThreads = std::max(1u, maxThreads);
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+
+    std::printf("%-8s %16s %16s %16s\n", "threads", "packed ns/upd", "aligned ns/upd", "agent dec/s");
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        std::vector<PackedHotState> packed(threads);
+        std::vector<AgentHotState> aligned(threads);
+        // La barrera impide que el compilador junte las escrituras del bucle.
+        auto update = [&](auto& slot, uint64_t i) {
+            slot.currentRisk = (float)(i & 1023);
+            slot.decisionCount++;
+            if (i % 3 == 0) slot.overreactionCount++;
+            else slot.avoidedDangerCount++;
+            asm volatile("" ::: "memory");
+        };
+        double packedSeconds = timeThreads(threads, [&](unsigned t) {
+            for (uint64_t i = 0; i < updates; i++) update(packed[t], i);
+        });
+        double alignedSeconds = timeThreads(threads, [&](unsigned t) {
+            for (uint64_t i = 0; i < updates; i++) update(aligned[t], i);
+        });
+
+        std::vector<SyntheticSelf> agents(threads);
+        for (SyntheticSelf& agent : agents) agent.setVerbose(false);
+        double agentSeconds = timeThreads(threads, [&](unsigned t) {
+            SyntheticSelf::seedRandom(t);
+            for (int i = 0; i < decisions; i++)
+                agents[t].evaluateAction((float)(i % 10) / 10.0f, "overload", i % 3 == 0);
+        });
+        std::printf("%-8u %16.2f %16.2f %16.0f\n", threads, packedSeconds * 1e9 / updates,
+                    alignedSeconds * 1e9 / updates, threads * decisions / agentSeconds);
+    }
+    return 0;
+}
+
+/**
+ * @brief Routes decisions to random agents of a large population, per page backing.
+ *
+ * Usage: main numa-bench [agents per node] [decisions per node] [small|thp|huge-2m|huge-1g|all]
+ *
+ * Every NUMA node gets a worker pinned to its CPUs and a population whose
+ * agents, histories and maps live in a `ReplicaArena` over a
+ * `HugePageResource` bound to that node. Random routing touches a new
+ * agent on almost every decision, which is what makes TLB reach matter.
+ * The "got" columns show which backing the kernel really gave.
+ */
+static int runNumaBench(int argc, char** argv) {
+    int agentsPerNode = argc > 2 ? std::atoi(argv[2]) : 50000;
+    int decisions = argc > 3 ? std::atoi(argv[3]) : 2000000;
+    std::string which = argc > 4 ? argv[4] : "all";
+    std::vector<PageMode> pageModes;
+    for (PageMode mode : {PAGES_SMALL, PAGES_TRANSPARENT, PAGES_HUGETLB_2M, PAGES_HUGETLB_1G})
+        if (which == "all" || which == pageModeName(mode)) pageModes.push_back(mode);
+    if (pageModes.empty()) {
+        std::cerr << "unknown page mode: " << which << "\n";
+        return 1;
+    }
+
+    std::vector<NumaNode> nodes = numaNodes();
+    std::cout << "numa nodes: " << nodes.size() << "\n";
+    const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+
+    std::printf("%-8s %5s %10s %14s %10s %10s %10s %10s\n", "pages", "node", "ns/dec", "dec/s",
+                "MB mapped", "got huge", "got thp", "got small");
+    for (PageMode mode : pageModes) {
+        struct NodeResult {
+            double seconds = 0.0;
+            HugePageResource::Stats stats;
+            uint64_t thpBytes = 0;
+            bool pinned = false;
+        };
+        std::vector<NodeResult> results(nodes.size());
+        std::vector<std::thread> workers;
+        for (size_t n = 0; n < nodes.size(); n++) {
+            workers.emplace_back([&, n] {
+                NodeResult& result = results[n];
+                result.pinned = pinCurrentThread(nodes[n].cpus);
+                HugePageResource pages(mode, nodes.size() > 1 ? nodes[n].id : -1);
+                {
+                    ReplicaArena arena(64u << 20, &pages);
+                    std::pmr::vector<SyntheticSelf> agents(arena.resource());
+                    agents.reserve(agentsPerNode);
+                    SyntheticSelf::seedRandom(11 + (uint32_t)n);
+                    for (int a = 0; a < agentsPerNode; a++) {
+                        agents.emplace_back(arena.resource());
+                        agents.back().setVerbose(false);
+                        for (int i = 0; i < 4; i++) agents.back().logEvent(events[(a + i) % 4], (float)((a + i) % 10) / 10.0f);
+                    }
+                    result.thpBytes = anonHugePageBytes();
+
+                    uint32_t route = 2463534242u + (uint32_t)n;
+                    auto begin = std::chrono::steady_clock::now();
+                    for (int i = 0; i < decisions; i++) {
+                        // xorshift32: reparto aleatorio sin coste de <random>
+                        route ^= route << 13;
+                        route ^= route >> 17;
+                        route ^= route << 5;
+                        SyntheticSelf& agent = agents[route % (uint32_t)agentsPerNode];
+                        agent.evaluateAction((float)(route >> 24) / 255.0f, events[i & 3], (i & 7) == 0);
+                    }
+                    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                }
+                result.stats = pages.stats();
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+
+        for (size_t n = 0; n < nodes.size(); n++) {
+            const NodeResult& result = results[n];
+            const uint64_t* bytes = result.stats.bytes;
+            uint64_t mapped = bytes[PAGES_SMALL] + bytes[PAGES_TRANSPARENT] + bytes[PAGES_HUGETLB_2M] + bytes[PAGES_HUGETLB_1G];
+            std::printf("%-8s %5d %10.1f %14.0f %10.1f %10.1f %10.1f %10.1f%s\n", pageModeName(mode), nodes[n].id,
+                        result.seconds * 1e9 / decisions, decisions / result.seconds, mapped / 1048576.0,
+                        (bytes[PAGES_HUGETLB_2M] + bytes[PAGES_HUGETLB_1G]) / 1048576.0,
+                        std::min<uint64_t>(result.thpBytes, bytes[PAGES_TRANSPARENT]) / 1048576.0,
+                        bytes[PAGES_SMALL] / 1048576.0, result.pinned ? "" : " (unpinned)");
         }
     }
+    return 0;
+}
+
+/**
+ * @brief Compares plain and prefetched sweeps over a population larger than the caches.
+ *
+ * Usage: main sweep-bench [agents] [decisions] [distance]
+ *
+ * Every run builds the same population (same seeds, same warm-up
+ * histories), then routes `decisions` requests to random agents with
+ * `evaluateSweep`. Distance 0 is the plain loop. Every distance must give
+ * the same verdicts.
+ */
+static int runSweepBench(int argc, char** argv) {
+    int agentCount = argc > 2 ? std::atoi(argv[2]) : 50000;
+    int decisions = argc > 3 ? std::atoi(argv[3]) : 2000000;
+    std::vector<unsigned> distances = {0, 2, 4, 8, 16, 32};
+    if (argc > 4) distances = {0, (unsigned)std::atoi(argv[4])};
 
+    const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+    std::vector<uint32_t> ids(decisions);
+    std::vector<EvalRequest> requests(decisions);
+    uint32_t route = 2463534242u;
+    for (int i = 0; i < decisions; i++) {
+        route ^= route << 13;
+        route ^= route >> 17;
+        route ^= route << 5;
+        ids[i] = route % (uint32_t)agentCount;
+        requests[i] = {(float)(route >> 24) / 255.0f, events[i & 3], (i & 7) == 0};
+    }
 
+    std::vector<uint8_t> reference;
+    std::printf("%-9s %10s %14s %9s\n", "distance", "ns/dec", "dec/s", "speedup");
+    double baseline = 0.0;
+    for (unsigned distance : distances) {
+        std::vector<SyntheticSelf> agents(agentCount);
+        for (int a = 0; a < agentCount; a++) {
+            agents[a].setVerbose(false);
+            for (int i = 0; i < 8; i++) agents[a].logEvent(events[(a + i) % 4], (float)((a + i) % 10) / 10.0f);
+        }
+        SyntheticSelf::seedRandom(5);
+        std::vector<uint8_t> verdicts;
+        auto begin = std::chrono::steady_clock::now();
+        evaluateSweep(agents, ids, requests, verdicts, distance);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (distance == 0) {
+            baseline = seconds;
+            reference = verdicts;
+        } else if (verdicts != reference) {
+            std::cerr << "distance " << distance << " decided differently\n";
+            return 1;
+        }
+        std::printf("%-9u %10.1f %14.0f %8.2fx\n", distance, seconds * 1e9 / decisions, decisions / seconds,
+                    baseline / seconds);
+    }
+    return 0;
+}
+
+/**
+ * @brief Simulated clock for benches that compare saved states or replay time.
+ */
+static TimeMs benchNow = 0;
+
+static TimeMs benchClock() {
+    return benchNow;
+}
+
+/**
+ * @brief Checks that `evaluateBatch` decides exactly like `evaluateAction`.
+ *
+ * Usage: main batch-check [agents] [requests]
+ *
+ * First a known case where tracking the memory bias incrementally drifted
+ * from the rescanned sum, then random batches with runs of identical
+ * requests. Verdicts and saved state must match request by request.
+ */
+static int runBatchCheck(int argc, char** argv) {
+    int agentCount = argc > 2 ? std::atoi(argv[2]) : 200;
+    int requestCount = argc > 3 ? std::atoi(argv[3]) : 2000;
+
+    auto compare = [](const char* name, auto&& prepare, const std::vector<EvalRequest>& batch) {
+        std::string verdictsSeq, verdictsBatch, stateSeq, stateBatch;
+        SyntheticSelf sequential, batched;
+        for (SyntheticSelf* agent : {&sequential, &batched}) {
+            agent->setVerbose(false);
+            agent->setClock(benchClock);
+            prepare(*agent);
+        }
+        SyntheticSelf::seedRandom(1);
+        for (const EvalRequest& request : batch)
+            verdictsSeq += sequential.evaluateAction(request.risk, request.eventType, request.causedConsequence) ? '1' : '0';
+        SyntheticSelf::seedRandom(1);
+        std::vector<uint8_t> verdicts;
+        batched.evaluateBatch(batch, verdicts);
+        for (uint8_t v : verdicts) verdictsBatch += (char)('0' + v);
+        sequential.saveState(stateSeq);
+        batched.saveState(stateBatch);
+        if (verdictsSeq == verdictsBatch && stateSeq == stateBatch) return true;
+        std::cerr << name << ": evaluateAction " << verdictsSeq << " vs evaluateBatch " << verdictsBatch << "\n";
+        return false;
+    };
 
+    bool ok = compare("bias drift case", [](SyntheticSelf& agent) {
+        agent.setEventNecessity("shutdown", 0.849817812f);
+        agent.logEvent("shutdown", 0.9f);
+        agent.logEvent("shutdown", 0.55f);
+        agent.logEvent("shutdown", 0.35f);
+    }, std::vector<EvalRequest>(12, EvalRequest{0.653420746f, "shutdown", true}));
 
-    /**
-     * @brief Evaluates an action based on its estimated risk, event type, and potential consequences.
-     * 
-     * This function assesses the risk of an action and determines whether it should be accepted or denied.
-     * It calculates the pain associated with the risk, applies a necessity bias based on the event type,
-     * and checks if the action should be desensitized. The decision is logged, and counters for overreactions
-     * or avoided dangers are updated accordingly.
-     * 
-     * @param estimatedRisk The estimated risk level of the action as a float.
-     * @param eventType A string representing the type of event associated with the void evaluateAction*/
+    const char* events[] = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+    std::mt19937 gen(41);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int mismatches = 0;
+    for (int a = 0; a < agentCount; a++) {
+        std::vector<EvalRequest> batch;
+        while ((int)batch.size() < requestCount) {
+            EvalRequest request{uniform(gen), events[gen() % 4], gen() % 2 == 0};
+            batch.insert(batch.end(), 1 + gen() % 16, request);
+        }
+        float necessity = uniform(gen);
+        if (!compare("random batch", [&](SyntheticSelf& agent) {
+                agent.setEventNecessity("shutdown", 0.8f + necessity * 0.2f);
+            }, batch))
+            mismatches++;
+    }
+    std::cout << agentCount << " random batches, " << mismatches << " mismatches\n";
+    return ok && mismatches == 0 ? 0 : 1;
+}
 
-    void evaluateAction(float estimatedRisk, std::string eventType, bool causedConsequence = false) {
-        currentRisk = estimatedRisk;
-        float rawPain = riskToPain(currentRisk);
-        float dynamicThreshold = calculateDynamicThreshold();
-        float modifiedPain = applyNecessityBias(eventType, rawPain);
-        bool desensitized = shouldDesensitize(currentRisk);
+/**
+ * @brief Compares sequential, run-coalesced and event-grouped evaluation of mixed batches.
+ *
+ * Usage: main group-bench [batches] [batch size] [event types]
+ *
+ * Each batch goes to its own fresh agent and interleaves `event types`
+ * types, some with a necessity above the 0.8 cutoff. Every mode must end
+ * with the same verdicts and the same saved agent state as the sequential
+ * `evaluateAction` loop.
+ */
+static int runGroupBench(int argc, char** argv) {
+    int batches = argc > 2 ? std::atoi(argv[2]) : 2000;
+    int batchSize = argc > 3 ? std::atoi(argv[3]) : 256;
+    int typeCount = argc > 4 ? std::max(1, std::atoi(argv[4])) : 8;
 
-        riskMemory.push_back(currentRisk);
+    std::vector<std::string> types = {"overload", "shutdown", "logic_conflict", "external_interrupt"};
+    for (int t = (int)types.size(); t < typeCount; t++) types.push_back("event_" + std::to_string(t));
+    types.resize(typeCount);
 
-        std::cout << "Risk: " << currentRisk
-                  << " | Pain: " << modifiedPain
-                  << " | DynThreshold: " << dynamicThreshold
-                  << " | Desensitized: " << (desensitized ? "YES" : "NO") << "\n";
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<std::vector<EvalRequest>> work(batches);
+    for (auto& batch : work) {
+        batch.resize(batchSize);
+        for (int i = 0; i < batchSize; i++)
+            batch[i] = {std::round(uniform(gen) * 100.0f) / 100.0f, types[gen() % typeCount], gen() % 3 == 0};
+    }
 
-        if (!desensitized && modifiedPain >= dynamicThreshold) {
-            std::cout << "[ALERT] Action denied.\n";
-            if (!causedConsequence) {
-                overreactionCount++;
-                std::cout << "[NOTE] No negative consequence → overreaction noted.\n";
+    struct Mode {
+        const char* name;
+        int kind;
+        double seconds = 0.0;
+        std::vector<uint8_t> verdicts;
+        std::string state;
+    };
+    Mode modes[] = {{"sequential", 0}, {"batch", 1}, {"grouped", 2}};
+    // Dos vueltas; sólo cuenta la segunda, con el heap ya caliente para todos los modos.
+    for (int round = 0; round < 2; round++) {
+        for (Mode& mode : modes) {
+            mode.verdicts.clear();
+            mode.state.clear();
+            std::vector<SyntheticSelf> agents(batches);
+            for (SyntheticSelf& agent : agents) {
+                agent.setVerbose(false);
+                agent.setClock(benchClock); // los instantes forman parte del estado comparado
+                for (int t = 0; t < typeCount; t++) agent.setEventNecessity(types[t], t % 2 ? 0.95f : 0.5f);
             }
-        } else {
-            std::cout << "Action accepted.\n";
-            if (causedConsequence) {
-                logEvent(eventType, estimatedRisk);
-            } else {
-                avoidedDangerCount++;
+            SyntheticSelf::seedRandom(3);
+            std::vector<uint8_t> verdicts;
+            auto begin = std::chrono::steady_clock::now();
+            for (int b = 0; b < batches; b++) {
+                if (mode.kind == 0) {
+                    verdicts.resize(batchSize);
+                    for (int i = 0; i < batchSize; i++) {
+                        const EvalRequest& request = work[b][i];
+                        verdicts[i] = agents[b].evaluateAction(request.risk, request.eventType, request.causedConsequence) ? 1 : 0;
+                    }
+                } else if (mode.kind == 1) {
+                    agents[b].evaluateBatch(work[b], verdicts);
+                } else {
+                    agents[b].evaluateBatchGrouped(work[b], verdicts);
+                }
+                mode.verdicts.insert(mode.verdicts.end(), verdicts.begin(), verdicts.end());
             }
+            mode.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            for (const SyntheticSelf& agent : agents) agent.saveState(mode.state);
         }
     }
 
+    double requests = (double)batches * batchSize;
+    std::printf("%-11s %10s %14s %9s\n", "mode", "ns/req", "req/s", "speedup");
+    for (const Mode& mode : modes)
+        std::printf("%-11s %10.1f %14.0f %8.2fx\n", mode.name, mode.seconds * 1e9 / requests, requests / mode.seconds,
+                    modes[0].seconds / mode.seconds);
+    for (const Mode& mode : modes) {
+        if (mode.verdicts != modes[0].verdicts || mode.state != modes[0].state) {
+            std::cerr << mode.name << " differs from sequential evaluation\n";
+            return 1;
+        }
+    }
+    return 0;
+}
 
+/**
+ * @brief Checks and times windowed queries against a scan of the whole history.
+ *
+ * Usage: main window-bench [decisions] [step ms] [window minutes]
+ *
+ * One agent decides `decisions` random risks (0.01 grid), one every
+ * `step` ms of simulated time, logging an "overload" event on accepted
+ * consequences. A flat (time, risk) log kept on the side is the O(history)
+ * baseline: it is scanned with the same bucket-aligned window and risk
+ * bins, and must agree with the agent's indexed answers, before and after
+ * a save/load round trip.
+ */
+static int runWindowBench(int argc, char** argv) {
+    int decisions = argc > 2 ? std::atoi(argv[2]) : 100000;
+    TimeMs step = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+    TimeMs window = (argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 10) * 60 * 1000;
+    const float probe = 0.68f;
 
-    /**
-     * @brief Logs an event with a specified type and associated risk value.
-     * 
-     * This function calculates a weighted risk for the event based on its type
-     * and stores the event information in the event memory. If the event type
-     * is not found in the predefined weights, a default weight of 0.5 is used.
-     * The event details are also printed to the standard output.
-     * 
-     * @param eventType The type of the event as a string.
-     * @param risk The risk value associated with the event as a float.
-     */
-    void logEvent(std::string eventType, float risk) {
-        float weight = eventWeights.count(eventType) ? eventWeights[eventType] : 0.5f;
-        float weightedRisk = weight * risk;
-        eventMemory.push_back({eventType, weightedRisk});
-        std::cout << "[EVENT] " << eventType << " risk=" << weightedRisk << "\n";      
-    }
-
-
-    /**
-     * @brief Prints the risk history stored in the riskMemory container.
-     * 
-     * This function iterates through the riskMemory container and outputs
-     * each risk value to the standard output, separated by spaces. The
-     * output is prefixed with "Risk history: " and followed by a newline.
-     * 
-     * @note This function does not modify any member variables and is
-     * marked as a const member function.
-     */
-    void printRiskHistory() const {
-        std::cout << "Risk history: ";
-        for (float r : riskMemory) std::cout << r << " ";
-        std::cout << std::endl;
-    }
-
-    /**
-     * @brief Prints the contents of the event memory to the standard output.
-     * 
-     * This function iterates through the `eventMemory` container and outputs
-     * each event's key-value pair in the format "- key: value". The output
-     * is prefixed with "Event memory:" for clarity.
-     * 
-     * @note Assumes that `eventMemory` is a container of key-value pairs
-     *       (e.g., a `std::map` or `std::unordered_map`).
-     */
-    void printEventMemory() const {
-        std::cout << "Event memory:\n";
-        for (auto& e : eventMemory)
-            std::cout << "- " << e.first << ": " << e.second << "\n";
-    }
-
-    void printStats() const {
-        std::cout << "Avoided Dangers: " << avoidedDangerCount << "\n";
-        std::cout << "Overreactions: " << overreactionCount << "\n";
+    SyntheticSelf agent;
+    agent.setVerbose(false);
+    agent.setClock(benchClock);
+    agent.setWindowHistogram(true);
+    SyntheticSelf::seedRandom(9);
+    std::mt19937 gen(23);
+    std::vector<std::pair<TimeMs, float>> decided, events;
+    decided.reserve(decisions);
+    benchNow = 1700000000000ull;
+    for (int i = 0; i < decisions; i++) {
+        benchNow += step;
+        float risk = (float)(gen() % 101) / 100.0f;
+        bool consequence = gen() % 4 == 0;
+        bool accepted = agent.evaluateAction(risk, "overload", consequence);
+        decided.push_back({benchNow, risk});
+        if (accepted && consequence) events.push_back({benchNow, 0.8f * risk});
     }
 
-};
+    // Ventana alineada a bucket, igual que TimeBuckets.
+    const TimeMs width = TimeBuckets::kDefaultWidthMs;
+    const TimeMs from = benchNow - window;
+    const TimeMs fromBucket = from - from % width;
+    auto scan = [&](WindowStats& stats, uint64_t& similar, uint64_t& safe) {
+        stats = WindowStats();
+        similar = safe = 0;
+        for (const auto& d : decided) {
+            if (d.first < fromBucket) continue;
+            stats.decisions++;
+            stats.riskSum += d.second;
+            long bin = std::lround(d.second * kRiskBinsPerUnit);
+            if (bin >= std::lround((probe - 0.05f) * kRiskBinsPerUnit) &&
+                bin <= std::lround((probe + 0.05f) * kRiskBinsPerUnit)) {
+                similar++;
+                if (bin < std::lround(0.7f * kRiskBinsPerUnit)) safe++;
+            }
+        }
+        for (const auto& e : events) {
+            if (e.first < fromBucket) continue;
+            stats.events++;
+            stats.eventBias += e.second;
+        }
+    };
+
+    const int queries = 200;
+    WindowStats expected;
+    uint64_t similar = 0, safe = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) scan(expected, similar, safe);
+    double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / queries;
+    float expectedRate = similar > 0 ? (float)safe / similar : 0.0f;
+
+    WindowStats got;
+    float gotRate = 0.0f;
+    volatile float sink = 0.0f;
+    begin = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries * 1000; q++) {
+        got = agent.windowStats(window);
+        gotRate = agent.windowSuccessRate(probe, window);
+        sink = sink + gotRate;
+    }
+    double indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / (queries * 1000);
+
+    auto matches = [&](const WindowStats& stats, float rate) {
+        return stats.decisions == expected.decisions && stats.events == expected.events && rate == expectedRate &&
+               std::fabs(stats.riskSum - expected.riskSum) <= 1e-9 * std::max(1.0, expected.riskSum) &&
+               std::fabs(stats.eventBias - expected.eventBias) <= 1e-9 * std::max(1.0, expected.eventBias);
+    };
+    std::string state;
+    agent.saveState(state);
+    SyntheticSelf restored;
+    restored.setClock(benchClock);
+    restored.setWindowHistogram(true);
+    bool loaded = restored.loadState(state);
 
-int main() {
+    std::printf("history: %d decisions, %zu events over %.1f h; window %.0f min\n", decisions, events.size(),
+                (double)decisions * step / 3.6e6, window / 60000.0);
+    std::printf("window: %llu decisions, %llu events, success rate near %.2f = %.4f, bias %.2f\n",
+                (unsigned long long)got.decisions, (unsigned long long)got.events, probe, gotRate, got.eventBias);
+    std::printf("%-8s %14s\n", "query", "us/query");
+    std::printf("%-8s %14.3f\n", "scan", scanSeconds * 1e6);
+    std::printf("%-8s %14.3f\n", "indexed", indexSeconds * 1e6);
+    if (!matches(got, gotRate)) {
+        std::cerr << "indexed window differs from the history scan\n";
+        return 1;
+    }
+    if (!loaded || !matches(restored.windowStats(window), restored.windowSuccessRate(probe, window))) {
+        std::cerr << "window differs after save/load\n";
+        return 1;
+    }
+    std::cout << "indexed, scanned and reloaded windows agree\n";
+    return 0;
+}
+
+static int runDemo() {
     SyntheticSelf ai;
 
     ai.setEventNecessity("external_interrupt", 0.92f);
@@ -492,5 +1472,39 @@ int main() {
     ai.printEventMemory();
     ai.printStats();
 
+    // Percentiles de toda la flota: se fusionan los sketches de cada agente.
+    SyntheticSelf peer;
+    peer.evaluateAction(0.4f, "overload", false);
+    peer.evaluateAction(0.7f, "logic_conflict", true);
+    RiskSketch fleet;
+    fleet.merge(ai.getRiskSketch());
+    fleet.merge(peer.getRiskSketch());
+    std::cout << "Fleet risk p50/p95/p99: " << fleet.quantile(0.5)
+              << " / " << fleet.quantile(0.95)
+              << " / " << fleet.quantile(0.99) << "\n";
+
     return 0;
 }
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "daemon") return runDaemon(argc, argv);
+    if (mode == "loadgen") return runLoadGen(argc, argv);
+    if (mode == "shm-serve") return runShmServe(argc, argv);
+    if (mode == "shm-bench") return runShmBench(argc, argv);
+    if (mode == "registry-bench") return runRegistryBench(argc, argv);
+    if (mode == "store-bench") return runStoreBench(argc, argv);
+    if (mode == "stats-bench") return runStatsBench(argc, argv);
+    if (mode == "stats") return runStatsReader(argc, argv);
+    if (mode == "kernel-bench") return runKernelBench(argc, argv);
+    if (mode == "simd-check") return runSimdCheck(argc, argv);
+    if (mode == "repro-check") return runReproCheck(argc, argv);
+    if (mode == "replica-bench") return runReplicaBench(argc, argv);
+    if (mode == "hot-bench") return runHotBench(argc, argv);
+    if (mode == "numa-bench") return runNumaBench(argc, argv);
+    if (mode == "sweep-bench") return runSweepBench(argc, argv);
+    if (mode == "group-bench") return runGroupBench(argc, argv);
+    if (mode == "batch-check") return runBatchCheck(argc, argv);
+    if (mode == "window-bench") return runWindowBench(argc, argv);
+    return runDemo();
+}
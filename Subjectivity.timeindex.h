@@ -0,0 +1,356 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_TIMEINDEX_H
+#define SUBJECTIVITY_TIMEINDEX_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Subjectivity.snapshot.h"
+
+/**
+ * Milliseconds since the Unix epoch.
+ */
+using TimeMs = uint64_t;
+
+/**
+ * @brief The default agent clock: wall time, so windows survive hibernation.
+ */
+inline TimeMs wallClockMillis() {
+    return (TimeMs)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @class DeltaTimes
+ * @brief Append-only timestamps, stored as LEB128 varint deltas between runs of equal times.
+ *
+ * Entries are non-decreasing: a time earlier than the last one (a clock
+ * stepped back) is stored as the last one. Entries with the same time
+ * (a batch, or a coalesced run of requests) form one group: a varint of
+ * `delta << 1 | repeated`, then, if repeated, a varint of `count - 2`. A
+ * single entry a few milliseconds after the previous one takes one byte,
+ * and a run of any length two or three; the first group holds the
+ * absolute time. The group being appended to is encoded once it closes.
+ */
+class DeltaTimes {
+private:
+    std::pmr::vector<uint8_t> bytes;
+    TimeMs last = 0;        // instante del grupo abierto
+    TimeMs encodedLast = 0; // instante del último grupo ya codificado
+    uint64_t pending = 0;   // entradas del grupo abierto
+    uint64_t count = 0;
+
+    template <typename Out>
+    static void putVarint(Out& out, uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            out.push_back(value ? (uint8_t)(byte | 0x80) : byte);
+        } while (value);
+    }
+
+    template <typename Out>
+    static void putGroup(Out& out, uint64_t delta, uint64_t entries) {
+        putVarint(out, delta << 1 | (entries > 1 ? 1 : 0));
+        if (entries > 1) putVarint(out, entries - 2);
+    }
+
+    static bool getVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; pos < size && shift < 64; shift += 7) {
+            uint8_t byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Recorre los grupos codificados: fn(instante, entradas). false si están mal formados.
+    template <typename Fn>
+    static bool forEachGroup(const uint8_t* data, size_t size, Fn&& fn) {
+        TimeMs time = 0;
+        size_t pos = 0;
+        while (pos < size) {
+            uint64_t head, entries = 1;
+            if (!getVarint(data, size, pos, head)) return false;
+            if ((head & 1) && !getVarint(data, size, pos, entries)) return false;
+            if (head & 1) entries += 2;
+            time += head >> 1;
+            fn(time, entries);
+        }
+        return true;
+    }
+
+    void closeGroup() {
+        if (pending == 0) return;
+        putGroup(bytes, last - encodedLast, pending);
+        encodedLast = last;
+        pending = 0;
+    }
+
+public:
+    explicit DeltaTimes(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : bytes(resource) {}
+
+    /**
+     * @brief Appends `entries` entries at `time` and returns the time actually stored.
+     */
+    TimeMs append(TimeMs time, uint64_t entries = 1) {
+        if (entries == 0) return count > 0 ? last : time;
+        if (count > 0 && time < last) time = last;
+        if (pending == 0 || time != last) {
+            closeGroup();
+            last = time;
+        }
+        pending += entries;
+        count += entries;
+        return time;
+    }
+
+    /**
+     * @brief Calls `fn(time, entries)` for every group of equal times, oldest first.
+     */
+    template <typename Fn>
+    void forEachRun(Fn&& fn) const {
+        forEachGroup(bytes.data(), bytes.size(), fn);
+        if (pending > 0) fn(last, pending);
+    }
+
+    /**
+     * @brief Calls `fn(time)` for every entry, oldest first.
+     */
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachRun([&](TimeMs time, uint64_t entries) {
+            for (uint64_t i = 0; i < entries; i++) fn(time);
+        });
+    }
+
+    uint64_t size() const { return count; }
+    TimeMs lastTime() const { return last; }
+    size_t byteSize() const { return bytes.capacity(); }
+
+    void clear() {
+        bytes.clear();
+        last = encodedLast = 0;
+        pending = count = 0;
+    }
+
+    void save(std::string& out) const {
+        std::string encoded(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (pending > 0) putGroup(encoded, last - encodedLast, pending);
+        putRaw(out, count);
+        putString(out, encoded);
+    }
+
+    bool load(SnapshotReader& in) {
+        std::string encoded;
+        uint64_t expected;
+        if (!in.get(expected) || !in.getString(encoded)) return false;
+        clear();
+        bytes.assign(encoded.begin(), encoded.end());
+        // Comprueba que los grupos están bien terminados y suman `expected` entradas.
+        bool valid = forEachGroup(bytes.data(), bytes.size(), [&](TimeMs time, uint64_t entries) {
+            count += entries;
+            last = encodedLast = time;
+        });
+        return valid && count == expected;
+    }
+};
+
+/**
+ * Risks are binned to the nearest 0.05 for windowed similarity queries.
+ */
+constexpr int kRiskBins = 21;
+constexpr float kRiskBinsPerUnit = kRiskBins - 1;
+
+/**
+ * @struct TimeBucket
+ * @brief Aggregates of the decisions and events that fell in one bucket of time.
+ */
+struct TimeBucket {
+    TimeMs start = 0;
+    uint32_t decisions = 0;
+    uint32_t events = 0;
+    double riskSum = 0.0;
+    double eventBias = 0.0;
+};
+
+/**
+ * @struct RiskHistogram
+ * @brief Decisions of one bucket by risk bin; kept only when the histogram is enabled.
+ */
+struct RiskHistogram {
+    uint32_t bins[kRiskBins] = {};
+};
+
+/**
+ * @struct WindowStats
+ * @brief Totals over a window of time, from `TimeBuckets::stats`.
+ */
+struct WindowStats {
+    uint64_t decisions = 0;
+    uint64_t events = 0;
+    double riskSum = 0.0;
+    double eventBias = 0.0; // suma de riesgos ponderados, como eventMemoryBias
+
+    float averageRisk() const { return decisions > 0 ? (float)(riskSum / decisions) : 0.0f; }
+};
+
+/**
+ * @class TimeBuckets
+ * @brief Fixed-width time buckets over an agent's decisions and events.
+ *
+ * Only buckets that saw activity exist, sorted by time; buckets older
+ * than the retention are dropped as time advances. Times may arrive out
+ * of order (decisions and events are separate streams), but a time older
+ * than the retention is ignored. A window query adds up the
+ * buckets that overlap the window, so it costs O(buckets in window)
+ * whatever the history length. Windows are bucket-granular: the oldest
+ * bucket is counted whole.
+ *
+ * A bucket is 32 bytes. The risk histogram that `countNear` needs adds
+ * 84 bytes per bucket and is off unless `setHistogram(true)`.
+ */
+class TimeBuckets {
+private:
+    static constexpr size_t kNone = SIZE_MAX;
+
+    std::pmr::vector<TimeBucket> buckets;
+    std::pmr::vector<RiskHistogram> histograms; // en paralelo a buckets, o vacío
+    TimeMs width;
+    TimeMs retention;
+    bool histogram = false;
+
+    static int binOf(float risk) {
+        return std::clamp((int)std::lround(risk * kRiskBinsPerUnit), 0, kRiskBins - 1);
+    }
+
+    size_t insertAt(size_t index, TimeMs start) {
+        buckets.emplace(buckets.begin() + index)->start = start;
+        if (histogram) histograms.emplace(histograms.begin() + index);
+        return index;
+    }
+
+    // kNone si `time` ya quedó fuera de la retención.
+    size_t bucketFor(TimeMs time) {
+        TimeMs start = time - time % width;
+        if (buckets.empty() || buckets.back().start < start) {
+            size_t expired = 0;
+            while (expired < buckets.size() && buckets[expired].start + width + retention <= start) expired++;
+            buckets.erase(buckets.begin(), buckets.begin() + expired);
+            if (histogram) histograms.erase(histograms.begin(), histograms.begin() + expired);
+            return insertAt(buckets.size(), start);
+        }
+        if (buckets.back().start == start) return buckets.size() - 1;
+        // Más antiguo que el último bucket: otro flujo (decisiones frente a
+        // eventos) al reconstruir el índice.
+        if (start + width + retention <= buckets.back().start) return kNone;
+        auto it = std::lower_bound(buckets.begin(), buckets.end(), start,
+                                   [](const TimeBucket& bucket, TimeMs value) { return bucket.start < value; });
+        size_t index = it - buckets.begin();
+        return it != buckets.end() && it->start == start ? index : insertAt(index, start);
+    }
+
+    // fn(índice) por cada bucket que solapa la ventana, del más reciente al más antiguo.
+    template <typename Fn>
+    void forWindow(TimeMs now, TimeMs window, Fn&& fn) const {
+        TimeMs from = now > window ? now - window : 0;
+        for (size_t i = buckets.size(); i-- > 0 && buckets[i].start + width > from;)
+            if (buckets[i].start <= now) fn(i);
+    }
+
+public:
+    static constexpr TimeMs kDefaultWidthMs = 60 * 1000;
+    static constexpr TimeMs kDefaultRetentionMs = 60 * 60 * 1000;
+
+    /**
+     * @param width Bucket width in milliseconds.
+     * @param retention How far back windows can reach.
+     */
+    explicit TimeBuckets(std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                         TimeMs width = kDefaultWidthMs, TimeMs retention = kDefaultRetentionMs)
+        : buckets(resource), histograms(resource), width(std::max<TimeMs>(1, width)), retention(retention) {}
+
+    /**
+     * @brief Keeps (or drops) the per-bucket risk histogram; clears the index.
+     *
+     * The caller refills it, as after `clear`.
+     */
+    void setHistogram(bool enabled) {
+        histogram = enabled;
+        clear();
+    }
+
+    bool hasHistogram() const { return histogram; }
+
+    void addDecision(TimeMs time, float risk, uint64_t count = 1) {
+        size_t index = bucketFor(time);
+        if (index == kNone) return;
+        buckets[index].decisions += (uint32_t)count;
+        buckets[index].riskSum += (double)risk * count;
+        if (histogram) histograms[index].bins[binOf(risk)] += (uint32_t)count;
+    }
+
+    void addEvent(TimeMs time, float weightedRisk, uint64_t count = 1) {
+        size_t index = bucketFor(time);
+        if (index == kNone) return;
+        buckets[index].events += (uint32_t)count;
+        buckets[index].eventBias += (double)weightedRisk * count;
+    }
+
+    /**
+     * @brief Decision and event totals over the last `window` ms before `now`.
+     */
+    WindowStats stats(TimeMs now, TimeMs window) const {
+        WindowStats total;
+        forWindow(now, window, [&](size_t i) {
+            total.decisions += buckets[i].decisions;
+            total.events += buckets[i].events;
+            total.riskSum += buckets[i].riskSum;
+            total.eventBias += buckets[i].eventBias;
+        });
+        return total;
+    }
+
+    /**
+     * @brief Decisions within ±`radius` of `risk` in the window, and how many were below `safeBelow`.
+     *
+     * Same rule as the exact history scan, at the 0.05 bin resolution.
+     * Both are 0 without the histogram.
+     */
+    void countNear(TimeMs now, TimeMs window, float risk, float radius, float safeBelow,
+                   uint64_t& total, uint64_t& safe) const {
+        total = safe = 0;
+        if (!histogram) return;
+        int low = std::max(0, (int)std::lround((risk - radius) * kRiskBinsPerUnit));
+        int high = std::min(kRiskBins - 1, (int)std::lround((risk + radius) * kRiskBinsPerUnit));
+        int safeBins = (int)std::lround(safeBelow * kRiskBinsPerUnit); // bins [0, safeBins) son seguros
+        forWindow(now, window, [&](size_t i) {
+            for (int bin = low; bin <= high; bin++) {
+                total += histograms[i].bins[bin];
+                if (bin < safeBins) safe += histograms[i].bins[bin];
+            }
+        });
+    }
+
+    size_t bucketCount() const { return buckets.size(); }
+    size_t byteSize() const {
+        return buckets.capacity() * sizeof(TimeBucket) + histograms.capacity() * sizeof(RiskHistogram);
+    }
+    void clear() {
+        buckets.clear();
+        histograms.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_TRACE_H
+#define SUBJECTIVITY_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Subjectivity.clock.h"
+
+/**
+ * @class Tracer
+ * @brief Sampled span recorder that writes Chrome trace-event JSON (Perfetto).
+ *
+ * Each thread records into its own ring of `maxEventsPerThread` spans: once
+ * full, a new span overwrites the oldest, so a long-running daemon keeps its
+ * most recent activity in bounded memory. Sampling works on units of work:
+ * a loop calls `beginSample()` once per iteration (one daemon pass), and
+ * then every `TraceSpan` on that thread is either recorded or skipped until
+ * the next call. With tracing off or the unit not sampled, a span costs one
+ * thread-local flag check. Spans flagged `TRACE_ALWAYS` (rare events such as
+ * kill switches) are recorded whenever tracing is enabled.
+ *
+ * `writeChromeTrace` may run while other threads record: each buffer has its
+ * own lock, taken only to append a sampled span.
+ */
+class Tracer {
+public:
+    static constexpr size_t kDefaultMaxEvents = 1 << 20; // por hilo
+
+private:
+    struct Event {
+        const char* name; // literal: no se copia
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct Buffer {
+        std::mutex mutex;
+        std::vector<Event> events; // anillo; crece hasta maxEvents
+        size_t next = 0;           // posición del más antiguo una vez lleno
+        long tid;
+        uint64_t overwritten = 0;
+    };
+
+    struct ThreadState {
+        Buffer* buffer;
+        bool sampling;
+        uint64_t units;
+    };
+
+    static inline thread_local ThreadState local{nullptr, false, 0};
+
+    std::atomic<uint32_t> sampleEvery{0}; // 0 = desactivado
+    size_t maxEvents = kDefaultMaxEvents;
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    Buffer& threadBuffer() {
+        if (!local.buffer) {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            buffers.push_back(std::make_unique<Buffer>());
+            buffers.back()->tid = (long)syscall(SYS_gettid);
+            local.buffer = buffers.back().get();
+        }
+        return *local.buffer;
+    }
+
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    /**
+     * @brief Turns tracing on, recording one unit of work in `every`.
+     *
+     * @param every Sampling period (1 = every unit); 0 turns tracing off.
+     * @param maxEventsPerThread Spans kept per thread; older ones are overwritten.
+     *        Changing it discards the spans recorded so far.
+     */
+    void enable(uint32_t every, size_t maxEventsPerThread = kDefaultMaxEvents) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        maxEventsPerThread = std::max<size_t>(maxEventsPerThread, 1);
+        if (maxEventsPerThread != maxEvents) {
+            for (const auto& buffer : buffers) {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                buffer->overwritten += buffer->events.size();
+                buffer->events.clear();
+                buffer->next = 0;
+            }
+            maxEvents = maxEventsPerThread;
+        }
+        sampleEvery.store(every, std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return sampleEvery.load(std::memory_order_relaxed) != 0; }
+
+    /**
+     * @brief Starts a unit of work on the calling thread and decides whether to sample it.
+     */
+    static void beginSample() {
+        uint32_t every = instance().sampleEvery.load(std::memory_order_relaxed);
+        local.sampling = every != 0 && ++local.units % every == 0;
+    }
+
+    static bool sampling() { return local.sampling; }
+
+    void record(const char* name, uint64_t start, uint64_t end) {
+        Buffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() < maxEvents) {
+            buffer.events.push_back({name, start, end - start});
+            return;
+        }
+        buffer.events[buffer.next] = {name, start, end - start};
+        buffer.next = (buffer.next + 1) % buffer.events.size();
+        buffer.overwritten++;
+    }
+
+    /**
+     * @brief Writes every span still held as Chrome trace-event JSON, oldest first per thread.
+     *
+     * The file loads in chrome://tracing and ui.perfetto.dev; `otherData`
+     * carries how many spans the rings overwrote.
+     *
+     * @return false if the file cannot be written.
+     */
+    bool writeChromeTrace(const std::string& path) {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) return false;
+        std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        bool first = true;
+        uint64_t overwritten = 0;
+        long pid = (long)getpid();
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            overwritten += buffer->overwritten;
+            const size_t count = buffer->events.size();
+            for (size_t i = 0; i < count; i++) {
+                const Event& e = buffer->events[(buffer->next + i) % count];
+                std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"subjectivity\",\"ph\":\"X\","
+                             "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld}",
+                             first ? "" : ",", e.name, e.start / 1e3, e.duration / 1e3, pid, buffer->tid);
+                first = false;
+            }
+        }
+        std::fprintf(file, "\n],\"otherData\":{\"overwritten\":\"%llu\",\"sampleEvery\":\"%u\"}}\n",
+                     (unsigned long long)overwritten, sampleEvery.load(std::memory_order_relaxed));
+        return std::fclose(file) == 0;
+    }
+
+    size_t recorded() {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        size_t total = 0;
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            total += buffer->events.size();
+        }
+        return total;
+    }
+};
+
+enum TraceMode : uint8_t {
+    TRACE_SAMPLED,
+    TRACE_ALWAYS
+};
+
+/**
+ * @class TraceSpan
+ * @brief Records the lifetime of the scope as one span named `name`.
+ *
+ * `name` must outlive the tracer (use string literals).
+ */
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t start = 0;
+    bool on;
+
+public:
+    explicit TraceSpan(const char* name, TraceMode mode = TRACE_SAMPLED)
+        : name(name),
+          on(Tracer::sampling() || (mode == TRACE_ALWAYS && Tracer::instance().enabled())) {
+        if (on) start = monotonicNs();
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        if (on) Tracer::instance().record(name, start, monotonicNs());
+    }
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+  Subjectivity-AI by JennyLab with GPL3
+*/
+
+#ifndef SUBJECTIVITY_URING_H
+#define SUBJECTIVITY_URING_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+/**
+ * @class IoUring
+ * @brief Minimal io_uring wrapper on raw syscalls (no liburing dependency).
+ *
+ * Covers what the daemon and the journal need: SQE/CQE ring access,
+ * registered (fixed) buffers and a provided-buffer ring for multishot
+ * receive. `init` and `supports` tell whether the running kernel provides
+ * what is needed; callers fall back to epoll/write when it does not.
+ */
+class IoUring {
+private:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned localTail = 0; // SQEs preparadas aún no publicadas al kernel
+    unsigned unsubmitted = 0;
+
+    void* bufRing = MAP_FAILED;
+    size_t bufRingSize = 0;
+    unsigned bufRingMask = 0;
+    unsigned bufRingTail = 0;
+
+    static int sysSetup(unsigned entries, io_uring_params* p) {
+        return (int)syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    static int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    static int sysRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+        return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+    }
+
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (bufRing != MAP_FAILED) munmap(bufRing, bufRingSize);
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    /**
+     * @brief Creates the ring and maps the submission/completion queues.
+     *
+     * @return false if the kernel lacks io_uring or it is disabled by policy.
+     */
+    bool init(unsigned entries) {
+        io_uring_params params{};
+        ringFd = sysSetup(entries, &params);
+        if (ringFd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        cqRing = singleMmap ? sqRing
+                            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) return false;
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+        return true;
+    }
+
+    bool ready() const { return ringFd >= 0 && sqes != MAP_FAILED; }
+
+    /**
+     * @brief Checks that every opcode in `ops` is supported by this kernel.
+     */
+    bool supports(std::initializer_list<uint8_t> ops) const {
+        const unsigned maxOps = 256;
+        std::vector<char> storage(sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (sysRegister(ringFd, IORING_REGISTER_PROBE, probe, maxOps) < 0) return false;
+        for (uint8_t op : ops) {
+            if (op > probe->last_op) return false;
+            if (!(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns a zeroed SQE, or nullptr if the submission queue is full.
+     */
+    io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= sqEntries) return nullptr;
+        unsigned index = localTail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        localTail++;
+        unsubmitted++;
+        return sqe;
+    }
+
+    /**
+     * @brief Publishes prepared SQEs and optionally waits for completions.
+     *
+     * @param waitFor Minimum number of CQEs to wait for (0 = don't block).
+     * @return Number of SQEs consumed, or -errno.
+     */
+    int submit(unsigned waitFor = 0) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        unsigned count = unsubmitted;
+        unsubmitted = 0;
+        for (;;) {
+            int ret = sysEnter(ringFd, count, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0);
+            if (ret < 0 && errno == EINTR) {
+                if (waitFor == 0) return 0;
+                count = 0; // ya enviadas; sólo falta esperar
+                continue;
+            }
+            return ret < 0 ? -errno : ret;
+        }
+    }
+
+    /**
+     * @brief Returns the next completion, or nullptr if none is pending.
+     *        Call `cqeSeen` once the entry has been consumed.
+     */
+    io_uring_cqe* peekCqe() {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return nullptr;
+        return &cqes[head & cqMask];
+    }
+
+    void cqeSeen() {
+        __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief Registers fixed buffers for IORING_OP_READ_FIXED/WRITE_FIXED.
+     */
+    bool registerBuffers(const iovec* iov, unsigned count) {
+        return sysRegister(ringFd, IORING_REGISTER_BUFFERS, iov, count) == 0;
+    }
+
+    /**
+     * @brief Registers a provided-buffer ring (group `group`) for buffer-select receives.
+     *
+     * @param entries Number of buffer slots; must be a power of two.
+     */
+    bool setupBufferRing(unsigned entries, uint16_t group) {
+        bufRingSize = entries * sizeof(io_uring_buf);
+        bufRing = mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (bufRing == MAP_FAILED) return false;
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+        reg.ring_entries = entries;
+        reg.bgid = group;
+        if (sysRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+        bufRingMask = entries - 1;
+        bufRingTail = 0;
+        return true;
+    }
+
+    /**
+     * @brief Hands a buffer to the kernel; it becomes visible on `commitBuffers`.
+     */
+    void provideBuffer(void* addr, unsigned length, uint16_t bufferId) {
+        // En C++ el flex array de io_uring_buf_ring queda desplazado 8 bytes:
+        // la ring se indexa directamente como un array de io_uring_buf.
+        io_uring_buf* buf = static_cast<io_uring_buf*>(bufRing) + (bufRingTail & bufRingMask);
+        buf->addr = reinterpret_cast<uint64_t>(addr);
+        buf->len = length;
+        buf->bid = bufferId;
+        bufRingTail++;
+    }
+
+    void commitBuffers() {
+        // El tail del kernel se superpone al campo resv del primer io_uring_buf.
+        uint16_t* tail = &static_cast<io_uring_buf*>(bufRing)->resv;
+        __atomic_store_n(tail, (uint16_t)bufRingTail, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief True when the kernel is new enough for multishot receive (6.0+).
+     *
+     * There is no probe flag for multishot, so this falls back to the release.
+     */
+    static bool kernelHasMultishotRecv() {
+        utsname info{};
+        if (uname(&info) != 0) return false;
+        int major = 0;
+        if (std::sscanf(info.release, "%d.", &major) != 1) return false;
+        return major >= 6;
+    }
+};
+
+#endif